@@ -0,0 +1,33 @@
+#
+# all.tcl --
+#
+# Run all of the TclX benchmarks.  Options are:
+#
+#     -file pattern   Only run benchmark files matching the glob pattern.
+#     -match pattern  Only run benchmarks whose name matches the glob pattern.
+#     -label label    Label identifying the build in the results.
+#------------------------------------------------------------------------------
+#
+
+set benchDir [file dirname [info script]]
+set benchFiles *.bench
+set benchMatch *
+set benchLabel tclx
+
+foreach {option value} $argv {
+    switch -- $option {
+        -file {set benchFiles $value}
+        -match {set benchMatch $value}
+        -label {set benchLabel $value}
+        default {
+            error "unknown option \"$option\", expected -file, -match\
+                    or -label"
+        }
+    }
+}
+
+source [file join $benchDir benchlib.tcl]
+
+foreach file [lsort [glob -nocomplain -directory $benchDir $benchFiles]] {
+    source $file
+}
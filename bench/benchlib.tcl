@@ -0,0 +1,49 @@
+#
+# benchlib.tcl --
+#
+# Benchmark support routines.  Each benchmark writes one result line to
+# stdout, a Tcl list of the form:
+#
+#     label name description microseconds-per-iteration
+#
+# where label identifies the build being measured, so results from different
+# builds can be compared by compare.tcl or another script.
+#------------------------------------------------------------------------------
+#
+
+package require Tclx 8.4
+
+#
+# Run a benchmark body in the caller's context and report the average time
+# per iteration.  The body is run once before timing to warm up any caches.
+#
+proc Bench {name description iterations body} {
+    global benchLabel
+    if {![BenchMatch $name]} {
+        return
+    }
+    uplevel 1 $body
+    set usec [lindex [uplevel 1 [list time $body $iterations]] 0]
+    puts stdout [list $benchLabel $name $description $usec]
+    flush stdout
+}
+
+#
+# Determine if a benchmark was selected by the -match option.
+#
+proc BenchMatch {name} {
+    global benchMatch
+    foreach pattern $benchMatch {
+        if {[string match $pattern $name]} {
+            return 1
+        }
+    }
+    return 0
+}
+
+if {![info exists benchMatch]} {
+    set benchMatch *
+}
+if {![info exists benchLabel]} {
+    set benchLabel tclx
+}
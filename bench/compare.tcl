@@ -0,0 +1,44 @@
+#
+# compare.tcl --
+#
+# Compare the results of two benchmark runs.  Usage:
+#
+#     tclsh compare.tcl baseline-results new-results
+#
+# For each benchmark in both runs, writes a Tcl list of the form:
+#
+#     name baseline-usec new-usec new/baseline
+#
+# A ratio above 1.0 means the new build is slower.
+#------------------------------------------------------------------------------
+#
+
+proc ReadResults {fileName} {
+    set fh [open $fileName]
+    set results {}
+    while {[gets $fh line] >= 0} {
+        if {[llength $line] == 4} {
+            lappend results [lindex $line 1] [lindex $line 3]
+        }
+    }
+    close $fh
+    return $results
+}
+
+if {[llength $argv] != 2} {
+    puts stderr "wrong # args: compare.tcl baseline-results new-results"
+    exit 1
+}
+array set baseline [ReadResults [lindex $argv 0]]
+
+foreach {name usec} [ReadResults [lindex $argv 1]] {
+    if {![info exists baseline($name)]} {
+        continue
+    }
+    if {$baseline($name) > 0} {
+        set ratio [format %.2f [expr {double($usec) / $baseline($name)}]]
+    } else {
+        set ratio -
+    }
+    puts stdout [list $name $baseline($name) $usec $ratio]
+}
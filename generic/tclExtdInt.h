@@ -443,6 +443,19 @@ TclXOSsetitimer _ANSI_ARGS_((Tcl_Interp *interp,
                              double     *seconds,
                              char       *funcName));
 
+typedef void TclXOSTimerProc _ANSI_ARGS_((void));
+
+extern int
+TclXOSsetproftimer _ANSI_ARGS_((Tcl_Interp      *interp,
+                                long             usecs,
+                                TclXOSTimerProc *tickProc,
+                                char            *funcName));
+
+extern int
+TclXOSheapsize _ANSI_ARGS_((Tcl_Interp  *interp,
+                            Tcl_WideInt *sizePtr,
+                            char        *funcName));
+
 extern void
 TclXOSsleep _ANSI_ARGS_((unsigned seconds));
 
@@ -470,8 +483,8 @@ TclX_OSsymlink _ANSI_ARGS_((Tcl_Interp *interp,
                             char       *funcName));
 
 extern void
-TclXOSElapsedTime _ANSI_ARGS_((clock_t *realTime,
-                               clock_t *cpuTime));
+TclXOSElapsedTime _ANSI_ARGS_((Tcl_WideInt *realTime,
+                               Tcl_WideInt *cpuTime));
 
 extern int
 TclXOSkill _ANSI_ARGS_((Tcl_Interp *interp,
@@ -120,6 +120,8 @@ EXTERN char *	TclX_UpShift _ANSI_ARGS_((char	     *targetStr,
  */
 EXTERN Tcl_Obj * TclX_NewKeyedListObj _ANSI_ARGS_((void));
 
+EXTERN Tcl_Obj * TclX_NewSizedKeyedListObj _ANSI_ARGS_((int numEntries));
+
 EXTERN int	TclX_KeyedListGet _ANSI_ARGS_((Tcl_Interp *interp,
 			       Tcl_Obj	  *keylPtr,
 			       char	  *key,
@@ -139,6 +141,40 @@ EXTERN int	TclX_KeyedListGetKeys _ANSI_ARGS_((Tcl_Interp *interp,
 				   char	      *key,
 				   Tcl_Obj   **listObjPtrPtr));
 
+EXTERN int	TclX_KeyedListGetMany _ANSI_ARGS_((Tcl_Interp *interp,
+				   Tcl_Obj    *keylPtr,
+				   int	       numKeys,
+				   char	     **keys,
+				   Tcl_Obj   **valuePtrs));
+
+EXTERN int	TclX_KeyedListSetMany _ANSI_ARGS_((Tcl_Interp *interp,
+				   Tcl_Obj    *keylPtr,
+				   int	       numKeys,
+				   char	     **keys,
+				   Tcl_Obj   **valuePtrs));
+
+EXTERN int	TclX_KeyedListSetPairs _ANSI_ARGS_((Tcl_Interp *interp,
+				    Tcl_Obj    *keylPtr,
+				    Tcl_Obj    *pairListPtr));
+
+EXTERN int	TclX_KeyedListSerialize _ANSI_ARGS_((Tcl_Interp *interp,
+				     Tcl_Obj	*keylPtr,
+				     Tcl_Obj   **dataPtrPtr));
+
+EXTERN int	TclX_KeyedListDeserialize _ANSI_ARGS_((Tcl_Interp *interp,
+				       Tcl_Obj	  *dataPtr,
+				       Tcl_Obj	 **keylPtrPtr));
+
+#if (TCL_MAJOR_VERSION > 8) || (TCL_MINOR_VERSION >= 5)
+EXTERN int	TclX_KeyedListToDict _ANSI_ARGS_((Tcl_Interp *interp,
+				  Tcl_Obj    *keylPtr,
+				  Tcl_Obj   **dictPtrPtr));
+
+EXTERN int	TclX_DictToKeyedList _ANSI_ARGS_((Tcl_Interp *interp,
+				  Tcl_Obj    *dictPtr,
+				  Tcl_Obj   **keylPtrPtr));
+#endif
+
 /*
  * Exported handle table manipulation functions.
  */
@@ -24,6 +24,39 @@
 #define ARG_TRUNCATE_SIZE 40
 #define CMD_TRUNCATE_SIZE 60
 
+/*
+ * Number of commands in the filter cache before it is first swept of deleted
+ * commands.  After a sweep, the next is done when the cache doubles in size.
+ */
+#define CMD_TABLE_SWEEP_SIZE 64
+
+/*
+ * Event recorded in the ring buffer by cmdtrace ringbuffer.  The words of the
+ * command are kept as references to their objects, up to TRACE_EVENT_OBJS of
+ * them, and only formatted when the ring is dumped.  With noeval, the command
+ * text is copied to a single object instead.
+ */
+#define TRACE_EVENT_OBJS 6
+
+typedef struct traceEvent_t {
+    Tcl_WideInt       time;         /* Microseconds since the epoch.      */
+    int               level;        /* Eval or procedure level.           */
+    int               objc;         /* Words in command, 0 for noeval.    */
+    int               numObjs;      /* Number of objects referenced.      */
+    Tcl_Obj          *objv [TRACE_EVENT_OBJS];
+    } traceEvent_t;
+
+/*
+ * Result of checking a command against the include and exclude patterns,
+ * cached by command.  The command's epoch changes if it is renamed, so the
+ * check is redone.  A reference to the command is held while it is cached,
+ * so the address is not reused by another command.
+ */
+typedef struct traceCmd_t {
+    int               cmdEpoch;     /* Epoch of command when checked.     */
+    int               traced;       /* TRUE if the command is traced.     */
+    } traceCmd_t;
+
 typedef struct traceInfo_t {
     Tcl_Interp       *interp;
     Tcl_Trace         traceId;
@@ -33,9 +66,20 @@ typedef struct traceInfo_t {
     int               procCalls;
     int               depth;
     char             *callback;
+    Tcl_Obj          *callbackPrefix;
     Tcl_Obj          *errorStatePtr;
     Tcl_AsyncHandler  errorAsyncHandler;
     Tcl_Channel       channel;
+    traceEvent_t     *ring;
+    int               ringSize;
+    int               ringNext;
+    int               ringCount;
+    int               ringNoTruncate;   /* notruncate of the ring's trace.  */
+    Tcl_Obj          *includeList;  /* Command patterns to trace or NULL. */
+    Tcl_Obj          *excludeList;  /* Command patterns to skip or NULL.  */
+    Tcl_Obj          *nsList;       /* Namespaces to trace or NULL.       */
+    Tcl_HashTable    *cmdTable;     /* traceCmd_t, keyed by command.      */
+    int               cmdSweepSize; /* Size of cmdTable at next sweep.    */
     } traceInfo_t, *traceInfo_pt;
 
 /*
@@ -45,6 +89,29 @@ static void
 TraceDelete _ANSI_ARGS_((Tcl_Interp   *interp,
                          traceInfo_pt  infoPtr));
 
+static void
+RingFree _ANSI_ARGS_((traceInfo_pt infoPtr));
+
+static void
+FilterFree _ANSI_ARGS_((traceInfo_pt infoPtr));
+
+static void
+FilterSweep _ANSI_ARGS_((traceInfo_pt infoPtr));
+
+static int
+FilterAppend _ANSI_ARGS_((Tcl_Obj      **listPtrPtr,
+                          Tcl_Obj       *valuePtr,
+                          int            isNamespace));
+
+static int
+FilterCommand _ANSI_ARGS_((traceInfo_pt  infoPtr,
+                           Tcl_Interp   *interp,
+                           Tcl_Command   cmd));
+
+static void
+PrintLevel _ANSI_ARGS_((Tcl_Channel  channel,
+                        int          level));
+
 static void
 PrintStr _ANSI_ARGS_((Tcl_Channel  channel,
                       CONST84 char *string,
@@ -57,11 +124,11 @@ PrintArg _ANSI_ARGS_((Tcl_Channel  channel,
                       int          noTruncate));
 
 static void
-TraceCode  _ANSI_ARGS_((traceInfo_pt infoPtr,
-                        int          level,
-                        char        *command,
-                        int          argc,
-                        CONST84 char **argv));
+TraceCode  _ANSI_ARGS_((traceInfo_pt    infoPtr,
+                        int             level,
+                        CONST84 char   *command,
+                        int             objc,
+                        Tcl_Obj *CONST  objv[]));
 
 static int
 TraceCallbackErrorHandler _ANSI_ARGS_((ClientData  clientData,
@@ -69,22 +136,26 @@ TraceCallbackErrorHandler _ANSI_ARGS_((ClientData  clientData,
                                        int         code));
 
 static void
-TraceCallBack _ANSI_ARGS_((Tcl_Interp   *interp,
-                           traceInfo_pt  infoPtr,
-                           int           level,
-                           char         *command,
-                           int           argc,
-                           CONST84 char **argv));
+TraceCallBack _ANSI_ARGS_((Tcl_Interp     *interp,
+                           traceInfo_pt    infoPtr,
+                           int             level,
+                           CONST84 char   *command,
+                           int             objc,
+                           Tcl_Obj *CONST  objv[]));
 
 static void
-CmdTraceRoutine _ANSI_ARGS_((ClientData    clientData,
-                             Tcl_Interp   *interp,
-                             int           level,
-                             char         *command,
-                             Tcl_CmdProc  *cmdProc,
-                             ClientData    cmdClientData,
-                             int           argc,
-                             CONST84 char **argv));
+RingRecord _ANSI_ARGS_((traceInfo_pt    infoPtr,
+                        int             level,
+                        CONST84 char   *command,
+                        int             objc,
+                        Tcl_Obj *CONST  objv[]));
+
+static Tcl_CmdObjTraceProc CmdTraceRoutine;
+
+static int
+RingDump _ANSI_ARGS_((Tcl_Interp   *interp,
+                      traceInfo_pt  infoPtr,
+                      Tcl_Obj      *channelId));
 
 static int
 TclX_CmdtraceObjCmd _ANSI_ARGS_((ClientData clientData, 
@@ -116,13 +187,277 @@ TraceDelete (interp, infoPtr)
             ckfree (infoPtr->callback);
             infoPtr->callback = NULL;
         }
+        if (infoPtr->callbackPrefix != NULL) {
+            Tcl_DecrRefCount (infoPtr->callbackPrefix);
+            infoPtr->callbackPrefix = NULL;
+        }
     }
     if (infoPtr->errorAsyncHandler != NULL) {
         Tcl_AsyncDelete (infoPtr->errorAsyncHandler);
         infoPtr->errorAsyncHandler = NULL;
     }
+    FilterFree (infoPtr);
 }
 
+/*-----------------------------------------------------------------------------
+ * RingFree --
+ *
+ *   Release the ring buffer, if there is one, and the objects its events
+ * refer to.
+ *-----------------------------------------------------------------------------
+ */
+static void
+RingFree (infoPtr)
+    traceInfo_pt  infoPtr;
+{
+    int idx, objIdx;
+
+    if (infoPtr->ring == NULL)
+        return;
+    for (idx = 0; idx < infoPtr->ringSize; idx++) {
+        for (objIdx = 0; objIdx < infoPtr->ring [idx].numObjs; objIdx++)
+            Tcl_DecrRefCount (infoPtr->ring [idx].objv [objIdx]);
+    }
+    ckfree ((char *) infoPtr->ring);
+    infoPtr->ring = NULL;
+    infoPtr->ringSize = 0;
+    infoPtr->ringNext = 0;
+    infoPtr->ringCount = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * FilterFree --
+ *
+ *   Release the trace filters and the cache of checked commands, releasing
+ * the references held on the commands.
+ *-----------------------------------------------------------------------------
+ */
+static void
+FilterFree (infoPtr)
+    traceInfo_pt  infoPtr;
+{
+    Tcl_HashEntry  *entryPtr;
+    Tcl_HashSearch  search;
+
+    if (infoPtr->includeList != NULL) {
+        Tcl_DecrRefCount (infoPtr->includeList);
+        infoPtr->includeList = NULL;
+    }
+    if (infoPtr->excludeList != NULL) {
+        Tcl_DecrRefCount (infoPtr->excludeList);
+        infoPtr->excludeList = NULL;
+    }
+    if (infoPtr->nsList != NULL) {
+        Tcl_DecrRefCount (infoPtr->nsList);
+        infoPtr->nsList = NULL;
+    }
+    if (infoPtr->cmdTable != NULL) {
+        for (entryPtr = Tcl_FirstHashEntry (infoPtr->cmdTable, &search);
+             entryPtr != NULL; entryPtr = Tcl_NextHashEntry (&search)) {
+            ckfree ((char *) Tcl_GetHashValue (entryPtr));
+            TclCleanupCommand ((Command *)
+                               Tcl_GetHashKey (infoPtr->cmdTable, entryPtr));
+        }
+        Tcl_DeleteHashTable (infoPtr->cmdTable);
+        ckfree ((char *) infoPtr->cmdTable);
+        infoPtr->cmdTable = NULL;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * FilterAppend --
+ *
+ *   Add a pattern or namespace to a list of trace filters, creating the list
+ * if needed.  Namespace names are made fully qualified, without a trailing
+ * "::", so the global namespace is an empty string.
+ *
+ * Parameters:
+ *   o listPtrPtr - Pointer to the list, which may be NULL.
+ *   o valuePtr - The pattern or namespace name.
+ *   o isNamespace - TRUE if this is a namespace name.
+ *-----------------------------------------------------------------------------
+ */
+static int
+FilterAppend (listPtrPtr, valuePtr, isNamespace)
+    Tcl_Obj      **listPtrPtr;
+    Tcl_Obj       *valuePtr;
+    int            isNamespace;
+{
+    char *nsName;
+    int   nsLen;
+
+    if (*listPtrPtr == NULL) {
+        *listPtrPtr = Tcl_NewListObj (0, NULL);
+        Tcl_IncrRefCount (*listPtrPtr);
+    }
+    if (isNamespace) {
+        nsName = Tcl_GetStringFromObj (valuePtr, &nsLen);
+        valuePtr = Tcl_NewStringObj ("::", 2);
+        while (*nsName == ':') {
+            nsName++;
+            nsLen--;
+        }
+        while ((nsLen > 0) && (nsName [nsLen - 1] == ':'))
+            nsLen--;
+        if (nsLen == 0) {
+            Tcl_SetObjLength (valuePtr, 0);
+        } else {
+            Tcl_AppendToObj (valuePtr, nsName, nsLen);
+        }
+    }
+    return Tcl_ListObjAppendElement (NULL, *listPtrPtr, valuePtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * FilterSweep --
+ *
+ *   Remove deleted commands from the cache of checked commands, releasing
+ * the references held on them, so a long running trace doesn't keep every
+ * command that was ever created and deleted.
+ *-----------------------------------------------------------------------------
+ */
+static void
+FilterSweep (infoPtr)
+    traceInfo_pt  infoPtr;
+{
+    Tcl_HashEntry  *entryPtr;
+    Tcl_HashSearch  search;
+    Command        *cmdPtr;
+
+    for (entryPtr = Tcl_FirstHashEntry (infoPtr->cmdTable, &search);
+         entryPtr != NULL; entryPtr = Tcl_NextHashEntry (&search)) {
+        cmdPtr = (Command *) Tcl_GetHashKey (infoPtr->cmdTable, entryPtr);
+        if (cmdPtr->flags & CMD_IS_DELETED) {
+            ckfree ((char *) Tcl_GetHashValue (entryPtr));
+            Tcl_DeleteHashEntry (entryPtr);
+            TclCleanupCommand (cmdPtr);
+        }
+    }
+    infoPtr->cmdSweepSize = 2 * infoPtr->cmdTable->numEntries;
+    if (infoPtr->cmdSweepSize < CMD_TABLE_SWEEP_SIZE)
+        infoPtr->cmdSweepSize = CMD_TABLE_SWEEP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------
+ * FilterCommand --
+ *
+ *   Determine if a command passes the trace filters.  If namespaces were
+ * specified, the command must be executed in one of them or a child of one.
+ * If include patterns were specified, the command name must match one of
+ * them, and it must not match any exclude pattern.  Patterns starting with
+ * "::" are matched against the fully qualified command name, others against
+ * the name without namespace qualifiers.  The result of matching the patterns
+ * is cached for the command.  Deleted commands are swept from the cache as it
+ * grows.
+ *
+ * Returns:
+ *   TRUE if the command is to be traced, FALSE if not.
+ *-----------------------------------------------------------------------------
+ */
+static int
+FilterCommand (infoPtr, interp, cmd)
+    traceInfo_pt  infoPtr;
+    Tcl_Interp   *interp;
+    Tcl_Command   cmd;
+{
+    Command       *cmdPtr = (Command *) cmd;
+    traceCmd_t    *cmdInfoPtr;
+    Tcl_HashEntry *entryPtr;
+    Tcl_Obj       *fullNameObj, **filterObjv;
+    char          *nsName, *filter, *cmdName;
+    int            filterObjc, filterLen, idx, isNew;
+
+    if (infoPtr->nsList != NULL) {
+        nsName = Tcl_GetCurrentNamespace (interp)->fullName;
+        Tcl_ListObjGetElements (NULL, infoPtr->nsList,
+                                &filterObjc, &filterObjv);
+        for (idx = 0; idx < filterObjc; idx++) {
+            filter = Tcl_GetStringFromObj (filterObjv [idx], &filterLen);
+            if ((strncmp (nsName, filter, filterLen) == 0) &&
+                ((nsName [filterLen] == '\0') || (nsName [filterLen] == ':')))
+                break;
+        }
+        if (idx == filterObjc)
+            return FALSE;
+    }
+
+    if (infoPtr->cmdTable == NULL)
+        return TRUE;
+
+    if (infoPtr->cmdTable->numEntries >= infoPtr->cmdSweepSize)
+        FilterSweep (infoPtr);
+    entryPtr = Tcl_CreateHashEntry (infoPtr->cmdTable, (char *) cmdPtr,
+                                    &isNew);
+    if (isNew) {
+        cmdInfoPtr = (traceCmd_t *) ckalloc (sizeof (traceCmd_t));
+        Tcl_SetHashValue (entryPtr, cmdInfoPtr);
+        cmdPtr->refCount++;
+    } else {
+        cmdInfoPtr = (traceCmd_t *) Tcl_GetHashValue (entryPtr);
+        if (cmdInfoPtr->cmdEpoch == cmdPtr->cmdEpoch)
+            return cmdInfoPtr->traced;
+    }
+    cmdInfoPtr->cmdEpoch = cmdPtr->cmdEpoch;
+
+    fullNameObj = Tcl_NewObj ();
+    Tcl_GetCommandFullName (interp, cmd, fullNameObj);
+    cmdInfoPtr->traced = (infoPtr->includeList == NULL);
+
+    if (infoPtr->includeList != NULL) {
+        Tcl_ListObjGetElements (NULL, infoPtr->includeList,
+                                &filterObjc, &filterObjv);
+        for (idx = 0; idx < filterObjc; idx++) {
+            filter = Tcl_GetStringFromObj (filterObjv [idx], NULL);
+            cmdName = STRNEQU (filter, "::", 2) ?
+                Tcl_GetStringFromObj (fullNameObj, NULL) :
+                (char *) Tcl_GetCommandName (interp, cmd);
+            if (Tcl_StringMatch (cmdName, filter)) {
+                cmdInfoPtr->traced = TRUE;
+                break;
+            }
+        }
+    }
+    if (cmdInfoPtr->traced && (infoPtr->excludeList != NULL)) {
+        Tcl_ListObjGetElements (NULL, infoPtr->excludeList,
+                                &filterObjc, &filterObjv);
+        for (idx = 0; idx < filterObjc; idx++) {
+            filter = Tcl_GetStringFromObj (filterObjv [idx], NULL);
+            cmdName = STRNEQU (filter, "::", 2) ?
+                Tcl_GetStringFromObj (fullNameObj, NULL) :
+                (char *) Tcl_GetCommandName (interp, cmd);
+            if (Tcl_StringMatch (cmdName, filter)) {
+                cmdInfoPtr->traced = FALSE;
+                break;
+            }
+        }
+    }
+    Tcl_DecrRefCount (fullNameObj);
+    return cmdInfoPtr->traced;
+}
+
+/*-----------------------------------------------------------------------------
+ * PrintLevel --
+ *
+ *   Print the level number of a trace line and indent for the level.
+ *-----------------------------------------------------------------------------
+ */
+static void
+PrintLevel (channel, level)
+    Tcl_Channel  channel;
+    int          level;
+{
+    int idx;
+    char buf [32];
+
+    sprintf (buf, "%2d:", level);
+    Tcl_Write (channel, buf, -1); 
+
+    if (level > 20)
+        level = 20;
+    for (idx = 0; idx < level; idx++) 
+        Tcl_Write (channel, "  ", 2);
+}
+
 /*-----------------------------------------------------------------------------
  * PrintStr --
  *
@@ -195,36 +530,29 @@ PrintArg (channel, argStr, noTruncate)
  *-----------------------------------------------------------------------------
  */
 static void
-TraceCode (infoPtr, level, command, argc, argv)
-    traceInfo_pt infoPtr;
-    int          level;
-    char        *command;
-    int          argc;
-    CONST84 char **argv;
+TraceCode (infoPtr, level, command, objc, objv)
+    traceInfo_pt    infoPtr;
+    int             level;
+    CONST84 char   *command;
+    int             objc;
+    Tcl_Obj *CONST  objv[];
 {
     int idx, cmdLen, printLen;
-    char buf [32];
 
-    sprintf (buf, "%2d:", level);
-    Tcl_Write(infoPtr->channel, buf, -1); 
-
-    if (level > 20)
-        level = 20;
-    for (idx = 0; idx < level; idx++) 
-        Tcl_Write (infoPtr->channel, "  ", 2);
+    PrintLevel (infoPtr->channel, level);
 
     if (infoPtr->noEval) {
         cmdLen = printLen = strlen (command);
         if ((!infoPtr->noTruncate) && (printLen > CMD_TRUNCATE_SIZE))
             printLen = CMD_TRUNCATE_SIZE;
 
-        PrintStr (infoPtr->channel, (CONST84 char *) command, printLen, FALSE);
+        PrintStr (infoPtr->channel, command, printLen, FALSE);
       } else {
-          for (idx = 0; idx < argc; idx++) {
+          for (idx = 0; idx < objc; idx++) {
               if (idx > 0)
                   Tcl_Write (infoPtr->channel, " ", 1);
               PrintArg (infoPtr->channel,
-                        argv [idx], 
+                        Tcl_GetStringFromObj (objv [idx], NULL),
                         infoPtr->noTruncate);
           }
     }
@@ -281,54 +609,67 @@ TraceCallbackErrorHandler (clientData, interp, code)
  * preserved by the procedure.  An error will result in an error being flagged
  * in the control block and async mark being called to handle the error
  * once the command has completed.
+ *   If the callback is a plain list of words, it is called directly with the
+ * arguments as objects, so the words of the traced command are passed on
+ * without being converted to strings.  Otherwise the command is built as a
+ * string and evaluated as a script.
  *-----------------------------------------------------------------------------
  */
 static void
-TraceCallBack (interp, infoPtr, level, command, argc, argv)
-    Tcl_Interp   *interp;
-    traceInfo_pt  infoPtr;
-    int           level;
-    char         *command;
-    int           argc;
-    CONST84 char **argv;
+TraceCallBack (interp, infoPtr, level, command, objc, objv)
+    Tcl_Interp     *interp;
+    traceInfo_pt    infoPtr;
+    int             level;
+    CONST84 char   *command;
+    int             objc;
+    Tcl_Obj *CONST  objv[];
 {
     Interp       *iPtr = (Interp *) interp;
     Tcl_DString   callback;
-    Tcl_Obj      *saveObjPtr;
-    char         *cmdList;
-    char          numBuf [32];
-
-    Tcl_DStringInit (&callback);
+    Tcl_Obj      *saveObjPtr, *cmdObjPtr, *argObjv [4], **cmdObjv;
+    int           idx, cmdObjc, result;
 
     /*
-     * Build the command to evaluate.
+     * Build the arguments.  The command text and the argument list are each
+     * passed as a list of one element.
      */
-    Tcl_DStringAppend (&callback, infoPtr->callback, -1);
-
-    Tcl_DStringStartSublist (&callback);
-    Tcl_DStringAppendElement (&callback, command);
-    Tcl_DStringEndSublist (&callback);
-
-    Tcl_DStringStartSublist (&callback);
-    cmdList = Tcl_Merge (argc, argv);
-    Tcl_DStringAppendElement (&callback, cmdList);
-    ckfree (cmdList);
-    Tcl_DStringEndSublist (&callback);
-
-    sprintf (numBuf, "%d", level);
-    Tcl_DStringAppendElement (&callback, numBuf);
-
-    sprintf (numBuf, "%d",  ((iPtr->varFramePtr == NULL) ? 0 : 
-             iPtr->varFramePtr->level));
-    Tcl_DStringAppendElement (&callback, numBuf);
+    argObjv [0] = Tcl_NewStringObj (command, -1);
+    argObjv [0] = Tcl_NewListObj (1, &argObjv [0]);
+    argObjv [1] = Tcl_NewListObj (objc, objv);
+    argObjv [1] = Tcl_NewListObj (1, &argObjv [1]);
+    argObjv [2] = Tcl_NewIntObj (level);
+    argObjv [3] = Tcl_NewIntObj ((iPtr->varFramePtr == NULL) ? 0 : 
+                                 iPtr->varFramePtr->level);
+    for (idx = 0; idx < 4; idx++)
+        Tcl_IncrRefCount (argObjv [idx]);
 
     saveObjPtr = TclX_SaveResultErrorInfo (interp);
 
     /*
-     * Evaluate the command.  If an error occurs, set up the handler to be
-     * called when its possible.
+     * Evaluate the command.  The command list holds its own references to the
+     * callback words, as the callback may delete the trace.  If an error
+     * occurs, set up the handler to be called when its possible.
      */
-    if (Tcl_Eval (interp, Tcl_DStringValue (&callback)) == TCL_ERROR) {
+    if (infoPtr->callbackPrefix != NULL) {
+        Tcl_ListObjGetElements (NULL, infoPtr->callbackPrefix,
+                                &cmdObjc, &cmdObjv);
+        cmdObjPtr = Tcl_NewListObj (cmdObjc, cmdObjv);
+        Tcl_ListObjReplace (NULL, cmdObjPtr, cmdObjc, 0, 4, argObjv);
+        Tcl_IncrRefCount (cmdObjPtr);
+        Tcl_ListObjGetElements (NULL, cmdObjPtr, &cmdObjc, &cmdObjv);
+        result = Tcl_EvalObjv (interp, cmdObjc, cmdObjv, 0);
+        Tcl_DecrRefCount (cmdObjPtr);
+    } else {
+        Tcl_DStringInit (&callback);
+        Tcl_DStringAppend (&callback, infoPtr->callback, -1);
+        for (idx = 0; idx < 4; idx++)
+            Tcl_DStringAppendElement (&callback,
+                                      Tcl_GetStringFromObj (argObjv [idx],
+                                                            NULL));
+        result = Tcl_Eval (interp, Tcl_DStringValue (&callback));
+        Tcl_DStringFree (&callback);
+    }
+    if (result == TCL_ERROR) {
         Tcl_AddObjErrorInfo (interp, "\n    (\"cmdtrace\" callback command)",
                              -1);
         infoPtr->errorStatePtr = TclX_SaveResultErrorInfo (interp);
@@ -337,26 +678,27 @@ TraceCallBack (interp, infoPtr, level, command, argc, argv)
 
     TclX_RestoreResultErrorInfo (interp, saveObjPtr);
 
-    Tcl_DStringFree (&callback);
+    for (idx = 0; idx < 4; idx++)
+        Tcl_DecrRefCount (argObjv [idx]);
 }
+
 
 /*-----------------------------------------------------------------------------
  * CmdTraceRoutine --
  *
- *  Routine called by Tcl_Eval to trace a command.
+ *  Routine called by Tcl_Eval to trace a command.  The command is recorded
+ * in the ring buffer, passed to the callback or printed.
  *-----------------------------------------------------------------------------
  */
-static void
-CmdTraceRoutine (clientData, interp, level, command, cmdProc, cmdClientData, 
-                 argc, argv)
+static int
+CmdTraceRoutine (clientData, interp, level, command, cmd, objc, objv)
     ClientData    clientData;
     Tcl_Interp   *interp;
     int           level;
-    char         *command;
-    Tcl_CmdProc  *cmdProc;
-    ClientData    cmdClientData;
-    int           argc;
-    CONST84 char **argv;
+    const char   *command;
+    Tcl_Command   cmd;
+    int           objc;
+    struct Tcl_Obj * const *objv;
 {
     Interp       *iPtr = (Interp *) interp;
     traceInfo_pt  infoPtr = (traceInfo_pt) clientData;
@@ -366,37 +708,182 @@ CmdTraceRoutine (clientData, interp, level, command, cmdProc, cmdClientData,
      * If we are in an error.  
      */
     if (infoPtr->inTrace || (infoPtr->errorStatePtr != NULL)) {
-        return;
+        return TCL_OK;
+    }
+    if (((infoPtr->nsList != NULL) || (infoPtr->cmdTable != NULL)) &&
+        !FilterCommand (infoPtr, interp, cmd)) {
+        return TCL_OK;
     }
-    infoPtr->inTrace = TRUE;
 
+    procLevel = level;
     if (infoPtr->procCalls) {
-        if (TclFindProc (iPtr, argv [0]) != NULL) {
-            if (infoPtr->callback != NULL) {
-                TraceCallBack (interp, infoPtr, level, command, argc, argv);
-            } else {
-                procLevel = (iPtr->varFramePtr == NULL) ? 0 : 
-                    iPtr->varFramePtr->level;
-                TraceCode (infoPtr, procLevel, command, argc, argv);
-            }
+        if (TclIsProc ((Command *) cmd) == NULL)
+            return TCL_OK;
+        procLevel = (iPtr->varFramePtr == NULL) ? 0 : 
+            iPtr->varFramePtr->level;
+    }
+    infoPtr->inTrace = TRUE;
+
+    if (infoPtr->ring != NULL) {
+        RingRecord (infoPtr, procLevel, command, objc, objv);
+    } else if (infoPtr->callback != NULL) {
+        TraceCallBack (interp, infoPtr, level, command, objc, objv);
+    } else {
+        TraceCode (infoPtr, procLevel, command, objc, objv);
+    }
+    infoPtr->inTrace = FALSE;
+    return TCL_OK;
+}
+
+
+/*-----------------------------------------------------------------------------
+ * RingRecord --
+ *
+ *  Record a command in the ring buffer.  The oldest event is overwritten,
+ * releasing the objects it refers to.
+ *-----------------------------------------------------------------------------
+ */
+static void
+RingRecord (infoPtr, level, command, objc, objv)
+    traceInfo_pt    infoPtr;
+    int             level;
+    CONST84 char   *command;
+    int             objc;
+    Tcl_Obj *CONST  objv[];
+{
+    traceEvent_t *eventPtr;
+    Tcl_Time      now;
+    CONST84 char *cmdEnd;
+    int           idx, cmdLen;
+
+    eventPtr = &infoPtr->ring [infoPtr->ringNext];
+    for (idx = 0; idx < eventPtr->numObjs; idx++)
+        Tcl_DecrRefCount (eventPtr->objv [idx]);
+
+    Tcl_GetTime (&now);
+    eventPtr->time = ((Tcl_WideInt) now.sec * 1000000) + now.usec;
+    eventPtr->level = level;
+
+    /*
+     * With noeval, keep one character more than is printed when truncating,
+     * so it is known to have been truncated.  The text is cut on a character
+     * boundary, so a multi-byte character is not split.
+     */
+    if (infoPtr->noEval) {
+        if (infoPtr->ringNoTruncate) {
+            cmdLen = strlen (command);
+        } else {
+            cmdEnd = command;
+            for (idx = 0; (idx <= CMD_TRUNCATE_SIZE) && (*cmdEnd != '\0');
+                 idx++)
+                cmdEnd = Tcl_UtfNext (cmdEnd);
+            cmdLen = cmdEnd - command;
         }
+        eventPtr->objc = 0;
+        eventPtr->numObjs = 1;
+        eventPtr->objv [0] = Tcl_NewStringObj (command, cmdLen);
+        Tcl_IncrRefCount (eventPtr->objv [0]);
     } else {
-        if (infoPtr->callback != NULL) {
-            TraceCallBack (interp, infoPtr, level, command, argc, argv);
+        eventPtr->objc = objc;
+        eventPtr->numObjs = (objc > TRACE_EVENT_OBJS) ? TRACE_EVENT_OBJS : objc;
+        for (idx = 0; idx < eventPtr->numObjs; idx++) {
+            eventPtr->objv [idx] = objv [idx];
+            Tcl_IncrRefCount (objv [idx]);
+        }
+    }
+
+    if (++infoPtr->ringNext == infoPtr->ringSize)
+        infoPtr->ringNext = 0;
+    if (infoPtr->ringCount < infoPtr->ringSize)
+        infoPtr->ringCount++;
+}
+
+/*-----------------------------------------------------------------------------
+ * RingDump --
+ *
+ *   Print the events in the ring buffer, oldest first, in the same format
+ * as a trace written to a file, with the time of the event in seconds since
+ * the epoch added to the start of each line.  Commands with more words than
+ * were kept are ended with "...".  The events are truncated as specified when
+ * the ring buffer trace was enabled.
+ *-----------------------------------------------------------------------------
+ */
+static int
+RingDump (interp, infoPtr, channelId)
+    Tcl_Interp   *interp;
+    traceInfo_pt  infoPtr;
+    Tcl_Obj      *channelId;
+{
+    Tcl_Channel   channel;
+    traceEvent_t *eventPtr;
+    int           idx, objIdx, eventIdx, cmdLen, printLen;
+    char         *cmdStr;
+    char          buf [64];
+
+    if (infoPtr->ring == NULL) {
+        TclX_AppendObjResult (interp, "no ring buffer trace has been ",
+                              "enabled", (char *) NULL);
+        return TCL_ERROR;
+    }
+    if (channelId == NULL) {
+        channel = TclX_GetOpenChannel (interp, "stdout", TCL_WRITABLE);
+    } else {
+        channel = TclX_GetOpenChannelObj (interp, channelId, TCL_WRITABLE);
+    }
+    if (channel == NULL)
+        return TCL_ERROR;
+
+    eventIdx = (infoPtr->ringCount < infoPtr->ringSize) ? 0 :
+        infoPtr->ringNext;
+    for (idx = 0; idx < infoPtr->ringCount; idx++) {
+        eventPtr = &infoPtr->ring [eventIdx];
+        if (++eventIdx == infoPtr->ringSize)
+            eventIdx = 0;
+
+        sprintf (buf, "%ld.%06ld ", (long) (eventPtr->time / 1000000),
+                 (long) (eventPtr->time % 1000000));
+        Tcl_Write (channel, buf, -1);
+        PrintLevel (channel, eventPtr->level);
+
+        if (eventPtr->objc == 0) {
+            cmdStr = Tcl_GetStringFromObj (eventPtr->objv [0], &cmdLen);
+            printLen = cmdLen;
+            if ((!infoPtr->ringNoTruncate) &&
+                (Tcl_GetCharLength (eventPtr->objv [0]) > CMD_TRUNCATE_SIZE))
+                printLen = Tcl_UtfAtIndex (cmdStr, CMD_TRUNCATE_SIZE) - cmdStr;
+            PrintStr (channel, cmdStr, printLen, FALSE);
         } else {
-            TraceCode (infoPtr, level, command, argc, argv);
+            for (objIdx = 0; objIdx < eventPtr->numObjs; objIdx++) {
+                if (objIdx > 0)
+                    Tcl_Write (channel, " ", 1);
+                PrintArg (channel,
+                          Tcl_GetStringFromObj (eventPtr->objv [objIdx],
+                                                NULL),
+                          infoPtr->ringNoTruncate);
+            }
+            if (eventPtr->objc > eventPtr->numObjs)
+                Tcl_Write (channel, " ...", 4);
         }
+        TclX_WriteNL (channel);
     }
-    infoPtr->inTrace = FALSE;
+    if (Tcl_Flush (channel) != TCL_OK) {
+        TclX_AppendObjResult (interp, "error writing \"",
+                              Tcl_GetChannelName (channel), "\": ",
+                              Tcl_PosixError (interp), (char *) NULL);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
 }
-
+
 /*-----------------------------------------------------------------------------
  * Tcl_CmdtraceObjCmd --
  *
  * Implements the TCL trace command:
  *     cmdtrace level|on ?noeval? ?notruncate? ?procs? ?fileid? ?command cmd?
+ *         ?ringbuffer size? ?include pattern? ?exclude pattern? ?namespace ns?
  *     cmdtrace off
  *     cmdtrace depth
+ *     cmdtrace dump ?fileid?
  *-----------------------------------------------------------------------------
  */
 static int
@@ -407,9 +894,10 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
     Tcl_Obj    *CONST objv[];
 {
     traceInfo_pt  infoPtr = (traceInfo_pt) clientData;
-    int idx;
+    int idx, ringSize;
     char *argStr, *callback;
     Tcl_Obj *channelId;
+    char numBuf [32];
 
     if (objc < 2)
         goto argumentError;
@@ -425,6 +913,15 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
         return TCL_OK;
     }
 
+    /*
+     * Handle `dump' sub-command, which leaves the trace running.
+     */
+    if (STREQU (argStr, "dump")) {
+        if (objc > 3)
+            goto argumentError;
+        return RingDump (interp, infoPtr, (objc == 3) ? objv [2] : NULL);
+    }
+
     /*
      * If a trace is in progress, delete it now.
      */
@@ -445,6 +942,7 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
     infoPtr->channel    = NULL;
     channelId           = NULL;
     callback            = NULL;
+    ringSize            = 0;
 
     if (STREQU (argStr, "on")) {
         infoPtr->depth = MAXINT;
@@ -479,6 +977,8 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
                 goto argumentError;
             if (callback != NULL)
                 goto mixCommandAndFile;
+            if (ringSize != 0)
+                goto mixRingBuffer;
             channelId = objv [idx];
             continue;
         }
@@ -487,16 +987,82 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
                 goto argumentError;
             if (channelId != NULL)
                 goto mixCommandAndFile;
+            if (ringSize != 0)
+                goto mixRingBuffer;
             if (idx == objc - 1)
-                goto missingCommand;
+                goto missingArgument;
             callback = Tcl_GetStringFromObj (objv [++idx], NULL);
             continue;
         }
+        if (STREQU (argStr, "include") || STREQU (argStr, "exclude") ||
+                STREQU (argStr, "namespace")) {
+            if (idx == objc - 1)
+                goto missingArgument;
+            if (FilterAppend ((argStr [0] == 'i') ? &infoPtr->includeList :
+                              (argStr [0] == 'e') ? &infoPtr->excludeList :
+                              &infoPtr->nsList,
+                              objv [++idx], (argStr [0] == 'n')) != TCL_OK)
+                return TCL_ERROR;
+            continue;
+        }
+        if (STREQU (argStr, "ringbuffer")) {
+            if (ringSize != 0)
+                goto argumentError;
+            if ((channelId != NULL) || (callback != NULL))
+                goto mixRingBuffer;
+            if (idx == objc - 1)
+                goto missingRingSize;
+            if (Tcl_GetIntFromObj (interp, objv [++idx], &ringSize) != TCL_OK)
+                return TCL_ERROR;
+            if (ringSize <= 0)
+                goto badRingSize;
+
+            /*
+             * The size passed to ckalloc is an unsigned int.
+             */
+            if ((unsigned) ringSize > UINT_MAX / sizeof (traceEvent_t))
+                goto ringSizeTooLarge;
+            continue;
+        }
         goto invalidOption;
     }
 
-    if (callback != NULL) {
+    /*
+     * A new trace replaces the events of the previous ring buffer trace.
+     */
+    RingFree (infoPtr);
+
+    if ((infoPtr->includeList != NULL) || (infoPtr->excludeList != NULL)) {
+        infoPtr->cmdTable = (Tcl_HashTable *) ckalloc (sizeof (Tcl_HashTable));
+        Tcl_InitHashTable (infoPtr->cmdTable, TCL_ONE_WORD_KEYS);
+        infoPtr->cmdSweepSize = CMD_TABLE_SWEEP_SIZE;
+    }
+
+    if (ringSize != 0) {
+        infoPtr->ring = (traceEvent_t *)
+            attemptckalloc (ringSize * sizeof (traceEvent_t));
+        if (infoPtr->ring == NULL)
+            goto ringAllocError;
+        for (idx = 0; idx < ringSize; idx++)
+            infoPtr->ring [idx].numObjs = 0;
+        infoPtr->ringSize = ringSize;
+        infoPtr->ringNoTruncate = infoPtr->noTruncate;
+    } else if (callback != NULL) {
         infoPtr->callback = ckstrdup (callback);
+
+        /*
+         * A callback that is a plain list of words is called with the
+         * arguments as objects rather than being evaluated as a script.
+         */
+        if (strpbrk (callback, "$[]\\;\"{}#\n\r") == NULL) {
+            infoPtr->callbackPrefix = Tcl_NewStringObj (callback, -1);
+            Tcl_IncrRefCount (infoPtr->callbackPrefix);
+            if ((Tcl_ListObjLength (NULL, infoPtr->callbackPrefix,
+                                    &idx) != TCL_OK) || (idx == 0)) {
+                Tcl_DecrRefCount (infoPtr->callbackPrefix);
+                infoPtr->callbackPrefix = NULL;
+            }
+        }
         infoPtr->errorAsyncHandler =
             Tcl_AsyncCreate (TraceCallbackErrorHandler, 
                              (ClientData) infoPtr);
@@ -515,21 +1081,26 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
             return TCL_ERROR;
     }
     infoPtr->traceId =
-        Tcl_CreateTrace (interp,
-                         infoPtr->depth,
-                         (Tcl_CmdTraceProc*) CmdTraceRoutine,
-                         (ClientData) infoPtr);
+        Tcl_CreateObjTrace (interp,
+                            infoPtr->depth,
+                            0,
+                            CmdTraceRoutine,
+                            (ClientData) infoPtr,
+                            NULL);
     return TCL_OK;
 
   argumentError:
-    TclX_AppendObjResult (interp, tclXWrongArgs, objv [0], 
-                          " level | on ?noeval? ?notruncate? ?procs?",
-                          "?fileid? ?command cmd? | off | depth",
+    TclX_AppendObjResult (interp, tclXWrongArgs,
+                          Tcl_GetStringFromObj (objv [0], NULL),
+                          " level | on ?noeval? ?notruncate? ?procs? ",
+                          "?fileid? ?command cmd? ?ringbuffer size? ",
+                          "?include pattern? ?exclude pattern? ",
+                          "?namespace ns? | off | depth | dump ?fileid?",
                           (char *) NULL);
     return TCL_ERROR;
 
-  missingCommand:
-    TclX_AppendObjResult (interp, "command option requires an argument",
+  missingArgument:
+    TclX_AppendObjResult (interp, argStr, " option requires an argument",
                           (char *) NULL);
     return TCL_ERROR;
 
@@ -538,10 +1109,44 @@ TclX_CmdtraceObjCmd (clientData, interp, objc, objv)
                           "and a file handle", (char *) NULL);
     return TCL_ERROR;
 
+  missingRingSize:
+    TclX_AppendObjResult (interp, "ringbuffer option requires a size",
+                          (char *) NULL);
+    return TCL_ERROR;
+
+  badRingSize:
+    TclX_AppendObjResult (interp, "ring buffer size must be greater than ",
+                          "zero, got \"",
+                          Tcl_GetStringFromObj (objv [idx], NULL), "\"",
+                          (char *) NULL);
+    return TCL_ERROR;
+
+  ringSizeTooLarge:
+    sprintf (numBuf, "%u", (unsigned) (UINT_MAX / sizeof (traceEvent_t)));
+    TclX_AppendObjResult (interp, "ring buffer size must not be greater ",
+                          "than ", numBuf, ", got \"",
+                          Tcl_GetStringFromObj (objv [idx], NULL), "\"",
+                          (char *) NULL);
+    return TCL_ERROR;
+
+  ringAllocError:
+    sprintf (numBuf, "%d", ringSize);
+    TclX_AppendObjResult (interp, "unable to allocate a ring buffer of ",
+                          numBuf, " commands", (char *) NULL);
+    return TCL_ERROR;
+
+  mixRingBuffer:
+    TclX_AppendObjResult (interp, "can not specify the ringbuffer option ",
+                          "with the command option or a file handle",
+                          (char *) NULL);
+    return TCL_ERROR;
+
   invalidOption:
     TclX_AppendObjResult (interp, "invalid option: expected ",
                           "one of \"noeval\", \"notruncate\", \"procs\", ",
-                          "\"command\", or a file id", (char *) NULL);
+                          "\"command\", \"ringbuffer\", \"include\", ",
+                          "\"exclude\", \"namespace\", or a file id",
+                          (char *) NULL);
     return TCL_ERROR;
 }
 
@@ -559,6 +1164,7 @@ DebugCleanUp (clientData, interp)
     traceInfo_pt infoPtr = (traceInfo_pt) clientData;
 
     TraceDelete (interp, infoPtr);
+    RingFree (infoPtr);
     ckfree ((char *) infoPtr);
 }
 
@@ -584,9 +1190,20 @@ TclX_DebugInit (interp)
     infoPtr->procCalls = FALSE;
     infoPtr->depth = 0;
     infoPtr->callback = NULL;
+    infoPtr->callbackPrefix = NULL;
     infoPtr->errorStatePtr = NULL;
     infoPtr->errorAsyncHandler = NULL;
     infoPtr->channel = NULL;
+    infoPtr->ring = NULL;
+    infoPtr->ringSize = 0;
+    infoPtr->ringNext = 0;
+    infoPtr->ringCount = 0;
+    infoPtr->ringNoTruncate = FALSE;
+    infoPtr->includeList = NULL;
+    infoPtr->excludeList = NULL;
+    infoPtr->nsList = NULL;
+    infoPtr->cmdTable = NULL;
+    infoPtr->cmdSweepSize = 0;
 
     Tcl_CallWhenDeleted (interp, DebugCleanUp, (ClientData) infoPtr);
 
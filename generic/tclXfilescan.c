@@ -27,6 +27,7 @@
 typedef struct matchDef_t {
     Tcl_RegExp          regExp;
     Tcl_Obj            *regExpObj;
+    char               *literal;    /* String any match contains, or NULL. */
     Tcl_Obj            *command;
     struct matchDef_t  *nextMatchDefPtr;
 } matchDef_t;
@@ -49,8 +50,10 @@ typedef struct {
     scanContext_t    *contextPtr;   /* Current scan context. */
     Tcl_Channel       channel;      /* The channel being scanned. */
     char             *line;         /* The line from the file. */
-    Tcl_UniChar      *uniLine;      /* UniCode (wide) char line. */
-    int               uniLineLen;
+    int               lineLen;      /* Length of the line in bytes. */
+    Tcl_DString      *uniLineBuf;   /* Buffer for the UniCode line. */
+    Tcl_UniChar      *uniLine;      /* UniCode (wide) char line, or NULL if
+                                       it has not been converted yet. */
     off_t             offset;       /* The offset into the file. */
     long              bytesRead;    /* Number of translated bytes read.*/
     long              lineNum;      /* Current scanned line in the file. */
@@ -61,6 +64,16 @@ typedef struct {
 /*
  * Prototypes of internal functions.
  */
+static void
+EndLiteralRun _ANSI_ARGS_((Tcl_DString *runPtr,
+                           Tcl_DString *bestPtr));
+
+static char *
+SkipBracket _ANSI_ARGS_((char *patPtr));
+
+static char *
+RegExpLiteral _ANSI_ARGS_((char *pattern));
+
 static void
 CleanUpContext _ANSI_ARGS_((void_pt         scanTablePtr,
                             scanContext_t  *contextPtr));
@@ -126,6 +139,212 @@ FileScanCleanUp _ANSI_ARGS_((ClientData  clientData,
                              Tcl_Interp *interp));
 
 
+/*-----------------------------------------------------------------------------
+ * EndLiteralRun --
+ *
+ *   End a run of literal characters found in a regular expression, keeping
+ * it if it is the longest found so far.
+ *-----------------------------------------------------------------------------
+ */
+static void
+EndLiteralRun (runPtr, bestPtr)
+    Tcl_DString *runPtr;
+    Tcl_DString *bestPtr;
+{
+    if (Tcl_DStringLength (runPtr) > Tcl_DStringLength (bestPtr)) {
+        Tcl_DStringSetLength (bestPtr, 0);
+        Tcl_DStringAppend (bestPtr, Tcl_DStringValue (runPtr),
+                           Tcl_DStringLength (runPtr));
+    }
+    Tcl_DStringSetLength (runPtr, 0);
+}
+
+/*-----------------------------------------------------------------------------
+ * SkipBracket --
+ *
+ *   Skip a bracket expression in a regular expression.
+ *
+ * Parameters:
+ *   o patPtr - Pointer to the `[' starting the bracket expression.
+ * Returns:
+ *   A pointer to the character after the closing `]', or NULL if it
+ * wasn't found.
+ *-----------------------------------------------------------------------------
+ */
+static char *
+SkipBracket (patPtr)
+    char *patPtr;
+{
+    char  endChar;
+
+    patPtr++;
+    if (*patPtr == '^')
+        patPtr++;
+    if (*patPtr == ']')
+        patPtr++;
+    while (*patPtr != ']') {
+        if (*patPtr == '\0')
+            return NULL;
+        if ((patPtr [0] == '[') && ((patPtr [1] == ':') ||
+                (patPtr [1] == '.') || (patPtr [1] == '='))) {
+            endChar = patPtr [1];
+            for (patPtr += 2; !((patPtr [0] == endChar) &&
+                                (patPtr [1] == ']')); patPtr++) {
+                if (*patPtr == '\0')
+                    return NULL;
+            }
+            patPtr += 2;
+            continue;
+        }
+        if ((patPtr [0] == '\\') && (patPtr [1] != '\0'))
+            patPtr++;
+        patPtr++;
+    }
+    return patPtr + 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * RegExpLiteral --
+ *
+ *   Find a string that every match of a regular expression must contain, so
+ * lines that don't contain it can be skipped without running the regular
+ * expression.  The longest run of literal characters outside of any group,
+ * and not made optional by a quantifier, is used.  Expressions with an
+ * alternative at the top level have no such string.  Anything that isn't
+ * understood, such as embedded options or most backslash escapes, ends the
+ * search, so the string may be shorter than it could be, but never wrong.
+ *
+ * Parameters:
+ *   o pattern - The regular expression, which has already been compiled.
+ * Returns:
+ *   A dynamically allocated string, or NULL if none was found.
+ *-----------------------------------------------------------------------------
+ */
+static char *
+RegExpLiteral (pattern)
+    char *pattern;
+{
+    Tcl_DString  run, best;
+    char        *patPtr, *nextPtr, *literal = NULL;
+    int          depth = 0, extracting = TRUE;
+
+    /*
+     * Director prefixes and embedded options change the syntax.
+     */
+    if ((strncmp (pattern, "***", 3) == 0) ||
+        ((pattern [0] == '(') && (pattern [1] == '?') &&
+         isalpha ((unsigned char) pattern [2])))
+        return NULL;
+
+    Tcl_DStringInit (&run);
+    Tcl_DStringInit (&best);
+
+    patPtr = pattern;
+    while (*patPtr != '\0') {
+        switch (*patPtr) {
+          case '\\':
+            if (patPtr [1] == '\0')
+                goto exitPoint;
+            nextPtr = (char *) Tcl_UtfNext (patPtr + 1);
+            if ((depth == 0) && extracting) {
+                if (isalnum ((unsigned char) patPtr [1])) {
+                    /*
+                     * Class shorthands, constraints, character entries and
+                     * back references.  Their length varies, so stop here.
+                     */
+                    EndLiteralRun (&run, &best);
+                    extracting = FALSE;
+                } else {
+                    Tcl_DStringAppend (&run, patPtr + 1, nextPtr - patPtr - 1);
+                }
+            }
+            patPtr = nextPtr;
+            break;
+          case '[':
+            EndLiteralRun (&run, &best);
+            patPtr = SkipBracket (patPtr);
+            if (patPtr == NULL)
+                goto exitPoint;
+            break;
+          case '(':
+            EndLiteralRun (&run, &best);
+            depth++;
+            patPtr++;
+            break;
+          case ')':
+            if (depth == 0)
+                goto exitPoint;
+            depth--;
+            patPtr++;
+            break;
+          case '|':
+            if (depth == 0)
+                goto exitPoint;
+            patPtr++;
+            break;
+          case '*':
+          case '?':
+          case '{':
+          case '+':
+            /*
+             * A brace that doesn't start a bound is an ordinary character.
+             */
+            if ((*patPtr == '{') && !isdigit ((unsigned char) patPtr [1])) {
+                if ((depth == 0) && extracting)
+                    Tcl_DStringAppend (&run, patPtr, 1);
+                patPtr++;
+                break;
+            }
+
+            /*
+             * The quantifier applies to the last character of the run.
+             * Unless at least one is required, it is not part of the run.
+             */
+            if ((depth == 0) && extracting) {
+                if ((*patPtr != '+') && (Tcl_DStringLength (&run) > 0)) {
+                    nextPtr = (char *) Tcl_UtfPrev (Tcl_DStringValue (&run) +
+                                                    Tcl_DStringLength (&run),
+                                                    Tcl_DStringValue (&run));
+                    Tcl_DStringSetLength (&run,
+                                          nextPtr - Tcl_DStringValue (&run));
+                }
+                EndLiteralRun (&run, &best);
+            }
+            if (*patPtr == '{') {
+                for (patPtr++; isdigit ((unsigned char) *patPtr) ||
+                         (*patPtr == ','); patPtr++)
+                    continue;
+                if (*patPtr != '}')
+                    goto exitPoint;
+            }
+            patPtr++;
+            break;
+          case '.':
+          case '^':
+          case '$':
+          case ']':
+          case '}':
+            EndLiteralRun (&run, &best);
+            patPtr++;
+            break;
+          default:
+            nextPtr = (char *) Tcl_UtfNext (patPtr);
+            if ((depth == 0) && extracting)
+                Tcl_DStringAppend (&run, patPtr, nextPtr - patPtr);
+            patPtr = nextPtr;
+            break;
+        }
+    }
+    EndLiteralRun (&run, &best);
+    if ((depth == 0) && (Tcl_DStringLength (&best) > 0))
+        literal = ckstrdup (Tcl_DStringValue (&best));
+
+  exitPoint:
+    Tcl_DStringFree (&run);
+    Tcl_DStringFree (&best);
+    return literal;
+}
+
 /*-----------------------------------------------------------------------------
  * CleanUpContext --
  *
@@ -142,6 +361,8 @@ CleanUpContext (scanTablePtr, contextPtr)
 
     for (matchPtr = contextPtr->matchListHead; matchPtr != NULL;) {
         Tcl_DecrRefCount(matchPtr->regExpObj);
+        if (matchPtr->literal != NULL)
+            ckfree (matchPtr->literal);
         if (matchPtr->command != NULL)
             Tcl_DecrRefCount (matchPtr->command);
         oldMatchPtr = matchPtr;
@@ -469,6 +690,17 @@ TclX_ScanmatchObjCmd (clientData, interp, objc, objv)
 
     newmatch->regExpObj = objv[firstArg + 1],
     Tcl_IncrRefCount (newmatch->regExpObj);
+
+    /*
+     * Find a string the lines matched must contain, so the other lines can
+     * be skipped cheaply.  This isn't done when ignoring case.
+     */
+    if (regExpFlags & TCL_REG_NOCASE) {
+        newmatch->literal = NULL;
+    } else {
+        newmatch->literal =
+            RegExpLiteral (Tcl_GetStringFromObj (newmatch->regExpObj, NULL));
+    }
     newmatch->command = objv [firstArg + 2];
     Tcl_IncrRefCount (newmatch->command);
 
@@ -580,7 +812,17 @@ SetMatchInfoVar (interp, scanData)
         goto exitPoint;
     }
 
+    /*
+     * The match offsets are in characters, so the line is converted to
+     * UniCode the first time a match on it has subexpressions.
+     */
     Tcl_RegExpGetInfo(scanData->matchPtr->regExp, &regExpInfo);
+    if ((regExpInfo.nsubs > 0) && (scanData->uniLine == NULL)) {
+        Tcl_DStringSetLength (scanData->uniLineBuf, 0);
+        scanData->uniLine = Tcl_UtfToUniCharDString (scanData->line,
+                                                     scanData->lineLen,
+                                                     scanData->uniLineBuf);
+    }
     for (idx = 0; idx < regExpInfo.nsubs; idx++) {
 	start = regExpInfo.matches[idx+1].start;
 	end = regExpInfo.matches[idx+1].end;
@@ -603,7 +845,7 @@ SetMatchInfoVar (interp, scanData)
         Tcl_DStringSetLength(&valueBuf, 0);
         value = Tcl_UniCharToUtfDString(scanData->uniLine + start, end - start,
                                         &valueBuf);
-        valueObjPtr = Tcl_NewStringObj(value, (end - start));
+        valueObjPtr = Tcl_NewStringObj(value, Tcl_DStringLength(&valueBuf));
 
         if (Tcl_SetVar2Ex(interp, MATCHINFO, key, valueObjPtr,
                             TCL_LEAVE_ERR_MSG) == NULL) {
@@ -649,6 +891,7 @@ ScanFile (interp, contextPtr, channel)
     data.channel = channel;
     data.bytesRead = 0;
     data.lineNum = 0;
+    data.uniLineBuf = &uniLineBuf;
     
     Tcl_DStringInit (&lineBuf);
     Tcl_DStringInit (&uniLineBuf);
@@ -671,16 +914,11 @@ ScanFile (interp, contextPtr, channel)
 
 
         data.line = Tcl_DStringValue(&lineBuf);
+        data.lineLen = Tcl_DStringLength(&lineBuf);
         data.bytesRead += (lineBuf.length + 1);  /* Include EOLN */
         data.lineNum++;
         data.storedLine = FALSE;
-
-        /* Convert to UTF to UniCode */
-        Tcl_DStringSetLength (&uniLineBuf, 0);
-        data.uniLine = Tcl_UtfToUniCharDString(Tcl_DStringValue(&lineBuf),
-                                               Tcl_DStringLength(&lineBuf),
-                                               &uniLineBuf);
-        data.uniLineLen = Tcl_DStringLength(&uniLineBuf) / sizeof(Tcl_UniChar);
+        data.uniLine = NULL;  /* Converted to UniCode only when needed. */
 
         matchedAtLeastOne = FALSE;
 
@@ -688,6 +926,10 @@ ScanFile (interp, contextPtr, channel)
              data.matchPtr != NULL; 
              data.matchPtr = data.matchPtr->nextMatchDefPtr) {
 
+            if ((data.matchPtr->literal != NULL) &&
+                (strstr (data.line, data.matchPtr->literal) == NULL)) {
+                continue;  /* Can't match, try next match pattern */
+            }
             matchStat = Tcl_RegExpExec(interp,
 		    data.matchPtr->regExp,
 		    Tcl_DStringValue(&lineBuf),
@@ -37,16 +37,64 @@
 /* #define NO_KEYLIST_HASH_TABLE */
 
 /*
- * An entry in a keyed list array.
+ * A keyed list key.  Keys are interned as atoms in a per-thread table, so
+ * each distinct key string is stored once no matter how many entries of how
+ * many keyed lists use it, and two keys are equal only if they are the same
+ * atom.  The string is stored following the structure.
+ */
+typedef struct {
+    char	 *key;	       /* Key string, NUL terminated.		*/
+    int		  keyLen;      /* Length of the key string.		*/
+    unsigned int  hash;	       /* Hash value of the key string.		*/
+    int		  refCount;    /* Entries and paths using the atom.	*/
+    Tcl_HashEntry *atomEntryPtr;  /* Entry in the atom table.		*/
+} keylKey_t;
+
+/*
+ * Internal representation of a key path object, a key string split at the
+ * `.' separators into the key atoms for each level of a keyed list.  It is
+ * reference counted so it can't be freed while in use if the key object
+ * shimmers.
+ */
+typedef struct {
+    int		refCount;     /* References to this path.		*/
+    int		numKeys;      /* Number of keys in the path.		*/
+    keylKey_t  *keys [1];     /* Keys, actually numKeys long.		*/
+} keylPath_t;
+
+/*
+ * Table of key atoms and counts of the lookups done by FindKeyedListEntry,
+ * reported by keylstats.  Tcl objects are only used by the thread that
+ * created them, so the data is per-thread and needs no locking.  The table is
+ * deleted when the last atom is released.
+ */
+typedef struct {
+    int		  initialized;	/* Has the atom table been initialized?	*/
+    Tcl_HashTable atomTable;	/* Key atoms, indexed by their string.	*/
+    unsigned long hashLookups;	/* Lookups in a hash index.		*/
+    unsigned long linearScans;	/* Lookups by linear scan.		*/
+    unsigned long scannedSlots;	/* Slots compared by scans.		*/
+} ThreadSpecificData;
+
+static Tcl_ThreadDataKey dataKey;
+
+/*
+ * An entry in a keyed list array.  Deleted entries are left in the array as
+ * empty slots (NULL keyPtr) so that deleting doesn't have to move the
+ * entries that follow or renumber the hash table.  The slots are squeezed
+ * out when they come to outnumber the live entries.
+ *
+ * Each entry caches its own part of the keyed list string, so regenerating
+ * the string of a modified keyed list only reformats the changed entries.
  *
  * JH: There was the supposition that making the key an object would
  * be faster, but I tried that and didn't find it to be true.  The
  * use of the layered hash table is a big win though.
  */
 typedef struct {
-    char *key;
-    int keyLen;
+    keylKey_t *keyPtr;
     Tcl_Obj *valuePtr;
+    Tcl_Obj *stringPtr;	      /* Entry formatted as a list element, or NULL */
 } keylEntry_t;
 
 /*
@@ -54,6 +102,7 @@ typedef struct {
  */
 typedef struct {
     int		 arraySize;   /* Current slots available in the array.	*/
+    int		 numSlots;    /* Slots used, including deleted ones.	*/
     int		 numEntries;  /* Number of actual entries in the array. */
     keylEntry_t *entries;     /* Array of keyed list entries.		*/
 #ifndef NO_KEYLIST_HASH_TABLE
@@ -63,22 +112,84 @@ typedef struct {
 } keylIntObj_t;
 
 /*
- * Amount to increment array size by when it needs to grow.
+ * Minimum size of a keyed list array.  Beyond this, the array doubles in
+ * size when it needs to grow, so appending entries one at a time takes
+ * amortized constant time.
+ */
+#define KEYEDLIST_ARRAY_MIN_SIZE 8
+
+/*
+ * Number of entries a keyed list must have before a hash table index is
+ * built for it.  Smaller lists are searched linearly, which is as fast and
+ * saves the memory of the table.  The index is built lazily on the first
+ * lookup, so copies of a keyed list regain their index as soon as they are
+ * accessed.  When present, the hash table always indexes every entry.
+ */
+#define KEYEDLIST_HASH_THRESHOLD 8
+
+/*
+ * Number of deleted slots a keyed list array must have before it is
+ * compacted, regardless of the number of live entries.
+ */
+#define KEYEDLIST_COMPACT_MIN_SIZE 16
+
+/*
+ * Totals for a keyed list and all of the keyed lists nested in it, collected
+ * by keylstats.
+ */
+typedef struct {
+    long numEntries;	/* Number of entries.				*/
+    long numChildren;	/* Number of values that are keyed lists.	*/
+    long keyBytes;	/* Bytes in the keys of the entries.		*/
+    long memBytes;	/* Approximate size of the internal reps.	*/
+} keylStats_t;
+
+
+/*
+ * Binary serialization format of a keyed list.  The data starts with a magic
+ * string that includes a version number, followed by the keyed list.  A
+ * keyed list is a count of entries, each entry is a length prefixed key, a
+ * type byte and either a length prefixed string value or a nested keyed
+ * list.  Integers are 32 bits, most significant byte first.
+ */
+#define KEYL_SERIAL_MAGIC	"TclXkl\001"
+#define KEYL_SERIAL_MAGIC_LEN	7
+#define KEYL_SERIAL_STRING	"s"
+#define KEYL_SERIAL_KEYED_LIST	"k"
+
+/*
+ * Maximum nesting depth of a serialized keyed list, protects the stack from
+ * corrupt data.
  */
-#define KEYEDLIST_ARRAY_INCR_SIZE 16
+#define KEYL_SERIAL_MAX_DEPTH	1000
 
 /*
  * Macro to duplicate a child entry of a keyed list if it is share by more
- * than the parent.
- * NO_KEYLIST_HASH_TABLE: We don't duplicate the hash table, so ensure
- * that consistency checks allow for portions where not all entries are
- * in the hash table.
+ * than the parent.  Copies of a keyed list share their child objects, so
+ * this must be done on every level of a key path before it is modified.
+ * Only the keyed lists on the path to the modified entry are copied.
  */
 #define DupSharedKeyListChild(keylIntPtr, idx) \
     if (Tcl_IsShared(keylIntPtr->entries [idx].valuePtr)) { \
-	keylIntPtr->entries [idx].valuePtr = \
-	    Tcl_DuplicateObj (keylIntPtr->entries [idx].valuePtr); \
+	Tcl_Obj *sharedPtr = keylIntPtr->entries [idx].valuePtr; \
+	keylIntPtr->entries [idx].valuePtr = Tcl_DuplicateObj (sharedPtr); \
 	Tcl_IncrRefCount(keylIntPtr->entries [idx].valuePtr); \
+	Tcl_DecrRefCount(sharedPtr); \
+    }
+
+/*
+ * Macro to add a reference to a key atom.  ReleaseKeyedListKey removes it.
+ */
+#define PreserveKeyedListKey(keyPtr) \
+    ((keyPtr)->refCount++)
+
+/*
+ * Macro to discard the cached string of an entry after its value changed.
+ */
+#define InvalidateKeyedListEntryString(entryPtr) \
+    if ((entryPtr)->stringPtr != NULL) { \
+	Tcl_DecrRefCount((entryPtr)->stringPtr); \
+	(entryPtr)->stringPtr = NULL; \
     }
 
 /*
@@ -106,6 +217,48 @@ ValidateKeyedList _ANSI_ARGS_((keylIntObj_t *keylIntPtr));
 static int
 ValidateKey _ANSI_ARGS_((Tcl_Interp *interp, char *key, int keyLen));
 
+static int
+ValidateEntryKey _ANSI_ARGS_((Tcl_Interp *interp, char *key, int keyLen));
+
+static unsigned int
+HashKeyedListKey _ANSI_ARGS_((CONST char *key, int keyLen));
+
+static keylKey_t *
+InternKeyedListKey _ANSI_ARGS_((CONST char *key,
+				int	    keyLen));
+
+static void
+ReleaseKeyedListKey _ANSI_ARGS_((keylKey_t *keyPtr));
+
+static unsigned int
+KeylHashKeyProc _ANSI_ARGS_((Tcl_HashTable *tablePtr,
+			     VOID	   *keyPtr));
+
+static int
+KeylCompareKeysProc _ANSI_ARGS_((VOID	       *keyPtr,
+				 Tcl_HashEntry *hPtr));
+
+static keylPath_t *
+AllocKeyedListPath _ANSI_ARGS_((CONST char *keyPath,
+				int	    keyPathLen));
+
+static keylPath_t *
+GetKeyedListPath _ANSI_ARGS_((Tcl_Obj *keyPathPtr));
+
+static void
+ReleaseKeyedListPath _ANSI_ARGS_((keylPath_t *pathPtr));
+
+static void
+FreeKeyedListPathInternalRep _ANSI_ARGS_((Tcl_Obj *keyPathPtr));
+
+static void
+DupKeyedListPathInternalRep _ANSI_ARGS_((Tcl_Obj *srcPtr,
+					 Tcl_Obj *copyPtr));
+
+static int
+SetKeyedListPathFromAny _ANSI_ARGS_((Tcl_Interp *interp,
+				     Tcl_Obj	*objPtr));
+
 static keylIntObj_t *
 AllocKeyedListIntRep _ANSI_ARGS_((void));
 
@@ -116,15 +269,30 @@ static void
 EnsureKeyedListSpace _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
 				  int		newNumEntries));
 
+#ifndef NO_KEYLIST_HASH_TABLE
+static void
+EnsureKeyedListHashTable _ANSI_ARGS_((keylIntObj_t *keylIntPtr));
+#endif
+
+static void
+CompactKeyedList _ANSI_ARGS_((keylIntObj_t *keylIntPtr));
+
+static int
+AddKeyedListEntry _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
+			       keylKey_t    *keyPtr,
+			       Tcl_Obj	    *valuePtr));
+
 static void
 DeleteKeyedListEntry _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
 				  int		entryIdx));
 
+static char *
+GetKeyedListEntryString _ANSI_ARGS_((keylEntry_t *entryPtr,
+				     int	 *lengthPtr));
+
 static int
 FindKeyedListEntry _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
-				char	     *key,
-				int	     *keyLenPtr,
-				char	    **nextSubKeyPtr));
+				keylKey_t    *keyPtr));
 
 static void
 DupKeyedListInternalRep _ANSI_ARGS_((Tcl_Obj *srcPtr,
@@ -140,6 +308,71 @@ SetKeyedListFromAny _ANSI_ARGS_((Tcl_Interp *interp,
 static void
 UpdateStringOfKeyedList _ANSI_ARGS_((Tcl_Obj *keylPtr));
 
+static int
+KeyedListGet _ANSI_ARGS_((Tcl_Interp *interp,
+			  Tcl_Obj    *keylPtr,
+			  keylPath_t *pathPtr,
+			  Tcl_Obj   **valuePtrPtr));
+
+static int
+KeyedListSet _ANSI_ARGS_((Tcl_Interp *interp,
+			  Tcl_Obj    *keylPtr,
+			  keylPath_t *pathPtr,
+			  int	      keyIdx,
+			  Tcl_Obj    *valuePtr));
+
+static int
+CheckKeyedListPairs _ANSI_ARGS_((Tcl_Interp *interp,
+				 Tcl_Obj    *keylPtr,
+				 int	     pairc,
+				 Tcl_Obj   **pairv));
+
+static int
+KeyedListDelete _ANSI_ARGS_((Tcl_Interp *interp,
+			     Tcl_Obj	*keylPtr,
+			     keylPath_t *pathPtr,
+			     int	 keyIdx));
+
+static int
+KeyedListGetKeys _ANSI_ARGS_((Tcl_Interp *interp,
+			      Tcl_Obj	 *keylPtr,
+			      keylPath_t *pathPtr,
+			      Tcl_Obj	**listObjPtrPtr));
+
+static void
+PutSerialInt _ANSI_ARGS_((Tcl_DString  *dataPtr,
+			  unsigned int  value));
+
+static int
+GetSerialInt _ANSI_ARGS_((unsigned char **dataPtrPtr,
+			  unsigned char  *endPtr,
+			  unsigned int   *valuePtr));
+
+static void
+SerializeKeyedList _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
+				Tcl_DString  *dataPtr));
+
+static Tcl_Obj *
+DeserializeKeyedList _ANSI_ARGS_((Tcl_Interp	 *interp,
+				  unsigned char **dataPtrPtr,
+				  unsigned char  *endPtr,
+				  int		  depth));
+
+static void
+AddKeyedListStat _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
+			      char	   *key,
+			      Tcl_Obj	   *valuePtr));
+
+static void
+CollectKeyedListStats _ANSI_ARGS_((keylIntObj_t *keylIntPtr,
+				   keylStats_t	*statsPtr));
+
+static int
+KeylgetVarsCmd _ANSI_ARGS_((Tcl_Interp  *interp,
+			    Tcl_Obj	*keylPtr,
+			    int		 objc,
+			    Tcl_Obj	*CONST objv[]));
+
 static int 
 TclX_KeylgetObjCmd _ANSI_ARGS_((ClientData   clientData,
 				Tcl_Interp  *interp,
@@ -152,6 +385,12 @@ TclX_KeylsetObjCmd _ANSI_ARGS_((ClientData   clientData,
 				int	     objc,
 				Tcl_Obj	    *CONST objv[]));
 
+static int
+TclX_KeylsetpairsObjCmd _ANSI_ARGS_((ClientData   clientData,
+				     Tcl_Interp  *interp,
+				     int	  objc,
+				     Tcl_Obj	 *CONST objv[]));
+
 static int 
 TclX_KeyldelObjCmd _ANSI_ARGS_((ClientData   clientData,
 				Tcl_Interp  *interp,
@@ -164,6 +403,38 @@ TclX_KeylkeysObjCmd _ANSI_ARGS_((ClientData   clientData,
 				 int	      objc,
 				 Tcl_Obj     *CONST objv[]));
 
+static int
+TclX_KeylserializeObjCmd _ANSI_ARGS_((ClientData   clientData,
+				      Tcl_Interp  *interp,
+				      int	   objc,
+				      Tcl_Obj	  *CONST objv[]));
+
+static int
+TclX_KeyldeserializeObjCmd _ANSI_ARGS_((ClientData   clientData,
+					Tcl_Interp  *interp,
+					int	     objc,
+					Tcl_Obj	    *CONST objv[]));
+
+static int
+TclX_KeylstatsObjCmd _ANSI_ARGS_((ClientData   clientData,
+				  Tcl_Interp  *interp,
+				  int	       objc,
+				  Tcl_Obj     *CONST objv[]));
+
+#if (TCL_MAJOR_VERSION > 8) || (TCL_MINOR_VERSION >= 5)
+static int
+TclX_Keyl2dictObjCmd _ANSI_ARGS_((ClientData   clientData,
+				  Tcl_Interp  *interp,
+				  int	       objc,
+				  Tcl_Obj     *CONST objv[]));
+
+static int
+TclX_Dict2keylObjCmd _ANSI_ARGS_((ClientData   clientData,
+				  Tcl_Interp  *interp,
+				  int	       objc,
+				  Tcl_Obj     *CONST objv[]));
+#endif
+
 /*
  * Type definition.
  */
@@ -175,6 +446,31 @@ static Tcl_ObjType keyedListType = {
     SetKeyedListFromAny	      /* setFromAnyProc */
 };
 
+/*
+ * Type definition of a key path, caches a key split into its sub-keys.  The
+ * string representation is never invalidated.
+ */
+static Tcl_ObjType keyedListPathType = {
+    "keyedListPath",		  /* name */
+    FreeKeyedListPathInternalRep, /* freeIntRepProc */
+    DupKeyedListPathInternalRep,  /* dupIntRepProc */
+    NULL,			  /* updateStringProc */
+    SetKeyedListPathFromAny	  /* setFromAnyProc */
+};
+
+/*
+ * Hash table key type for the atom table.  The hash table keys are pointers
+ * to the atoms, lookups are done with a keylKey_t that is not interned.
+ */
+static Tcl_HashKeyType keylHashKeyType = {
+    TCL_HASH_KEY_TYPE_VERSION,	  /* version */
+    0,				  /* flags */
+    KeylHashKeyProc,		  /* hashKeyProc */
+    KeylCompareKeysProc,	  /* compareKeysProc */
+    NULL,			  /* allocEntryProc */
+    NULL			  /* freeEntryProc */
+};
+
 
 /*-----------------------------------------------------------------------------
  * ValidateKeyedList --
@@ -188,9 +484,10 @@ static void
 ValidateKeyedList (keylIntPtr)
     keylIntObj_t *keylIntPtr;
 {
-    int idx;
+    int idx, numLive = 0;
 
-    TclX_Assert (keylIntPtr->arraySize >= keylIntPtr->numEntries);
+    TclX_Assert (keylIntPtr->arraySize >= keylIntPtr->numSlots);
+    TclX_Assert (keylIntPtr->numSlots >= keylIntPtr->numEntries);
     TclX_Assert (keylIntPtr->arraySize >= 0);
     TclX_Assert (keylIntPtr->numEntries >= 0);
     TclX_Assert ((keylIntPtr->arraySize > 0) ?
@@ -198,14 +495,40 @@ ValidateKeyedList (keylIntPtr)
     TclX_Assert ((keylIntPtr->numEntries > 0) ?
 		 (keylIntPtr->entries != NULL) : TRUE);
 
-    for (idx = 0; idx < keylIntPtr->numEntries; idx++) {
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
 	keylEntry_t *entryPtr = &(keylIntPtr->entries [idx]);
-	TclX_Assert (entryPtr->key != NULL);
+	if (entryPtr->keyPtr == NULL) {
+	    TclX_Assert (entryPtr->valuePtr == NULL);
+	    TclX_Assert (entryPtr->stringPtr == NULL);
+	    continue;
+	}
+	numLive++;
+	TclX_Assert (entryPtr->keyPtr->refCount >= 1);
+	TclX_Assert (entryPtr->keyPtr->hash ==
+		     HashKeyedListKey (entryPtr->keyPtr->key,
+				       entryPtr->keyPtr->keyLen));
 	TclX_Assert (entryPtr->valuePtr->refCount >= 1);
 	if (entryPtr->valuePtr->typePtr == &keyedListType) {
 	    ValidateKeyedList (entryPtr->valuePtr->internalRep.otherValuePtr);
 	}
+#ifndef NO_KEYLIST_HASH_TABLE
+	if (keylIntPtr->hashTbl != NULL) {
+	    Tcl_HashEntry *hashEntryPtr;
+
+	    hashEntryPtr = Tcl_FindHashEntry (keylIntPtr->hashTbl,
+					      (char *) entryPtr->keyPtr);
+	    TclX_Assert (hashEntryPtr != NULL);
+	    TclX_Assert ((int) Tcl_GetHashValue (hashEntryPtr) == idx);
+	}
+#endif
+    }
+    TclX_Assert (numLive == keylIntPtr->numEntries);
+#ifndef NO_KEYLIST_HASH_TABLE
+    if (keylIntPtr->hashTbl != NULL) {
+	TclX_Assert (keylIntPtr->hashTbl->numEntries ==
+		     keylIntPtr->numEntries);
     }
+#endif
 }
 #endif
 
@@ -240,787 +563,2026 @@ ValidateKey (interp, key, keyLen)
     return TCL_OK;
 }
 
-
 /*-----------------------------------------------------------------------------
- * AllocKeyedListIntRep --
- *   Allocate an and initialize the keyed list internal representation.
+ * ValidateEntryKey --
+ *   Check that the key of an entry being added to a keyed list from a list,
+ * string or other container is a valid value.  Unlike a key path, it may not
+ * contain sub-keys.
  *
+ * Parameters:
+ *   o interp - Used to return error messages.
+ *   o key - Key string to check.
+ *   o keyLen - Length of the string, used to check for binary data.
  * Returns:
- *    A pointer to the keyed list internal structure.
+ *    TCL_OK or TCL_ERROR.
  *-----------------------------------------------------------------------------
  */
-static keylIntObj_t *
-AllocKeyedListIntRep ()
+static int
+ValidateEntryKey (interp, key, keyLen)
+    Tcl_Interp *interp;
+    char *key;
+    int keyLen;
 {
-    keylIntObj_t *keylIntPtr;
-
-    keylIntPtr = (keylIntObj_t *) ckalloc (sizeof (keylIntObj_t));
-    memset(keylIntPtr, 0, sizeof (keylIntObj_t));
-#ifndef NO_KEYLIST_HASH_TABLE
-    keylIntPtr->hashTbl = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(keylIntPtr->hashTbl, TCL_STRING_KEYS);
-#endif
-    return keylIntPtr;
+    if (ValidateKey(interp, key, keyLen) == TCL_ERROR) {
+	return TCL_ERROR;
+    }
+    /*
+     * When setting from a random list/string, we cannot allow
+     * keys to have embedded '.' path separators
+     */
+    if ((strchr(key, '.') != NULL)) {
+	Tcl_AppendStringsToObj (Tcl_GetObjResult (interp),
+		"keyed list key may not contain a \".\"; ",
+		"it is used as a separator in key paths",
+		(char *) NULL);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
 }
+
 
+
 /*-----------------------------------------------------------------------------
- * FreeKeyedListData --
- *   Free the internal representation of a keyed list.
+ * HashKeyedListKey --
+ *   Compute the hash value of a key string.
  *
  * Parameters:
- *   o keylIntPtr - Keyed list internal structure to free.
+ *   o key - Key string to hash.
+ *   o keyLen - Length of the key string.
+ * Returns:
+ *    The hash value.
  *-----------------------------------------------------------------------------
  */
-static void
-FreeKeyedListData (keylIntPtr)
-    keylIntObj_t *keylIntPtr;
+static unsigned int
+HashKeyedListKey (key, keyLen)
+    CONST char *key;
+    int		keyLen;
 {
+    unsigned int hash = 0;
     int idx;
 
-    for (idx = 0; idx < keylIntPtr->numEntries ; idx++) {
-	ckfree (keylIntPtr->entries [idx].key);
-	Tcl_DecrRefCount(keylIntPtr->entries [idx].valuePtr);
-    }
-    if (keylIntPtr->entries != NULL)
-	ckfree ((VOID*) keylIntPtr->entries);
-#ifndef NO_KEYLIST_HASH_TABLE
-    if (keylIntPtr->hashTbl != NULL) {
-	Tcl_DeleteHashTable(keylIntPtr->hashTbl);
-	ckfree((char *) (keylIntPtr->hashTbl));
+    for (idx = 0; idx < keyLen; idx++) {
+	hash += (hash << 3) + (unsigned char) key [idx];
     }
-#endif
-    ckfree ((VOID*) keylIntPtr);
+    return hash;
 }
-
+
 /*-----------------------------------------------------------------------------
- * EnsureKeyedListSpace --
- *   Ensure there is enough room in a keyed list array for a certain number
- * of entries, expanding if necessary.
+ * InternKeyedListKey --
+ *   Find or create the atom for a key string and add a reference to it.
  *
  * Parameters:
- *   o keylIntPtr - Keyed list internal representation.
- *   o newNumEntries - The number of entries that are going to be added to
- *     the keyed list.
+ *   o key - Key string, it need not be NUL terminated.
+ *   o keyLen - Length of the key string.
+ * Returns:
+ *    A pointer to the atom.  ReleaseKeyedListKey must be called when done
+ * with it.
  *-----------------------------------------------------------------------------
  */
-static void
-EnsureKeyedListSpace (keylIntPtr, newNumEntries)
-    keylIntObj_t *keylIntPtr;
-    int		  newNumEntries;
+static keylKey_t *
+InternKeyedListKey (key, keyLen)
+    CONST char *key;
+    int		keyLen;
 {
-    KEYL_REP_ASSERT (keylIntPtr);
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+    keylKey_t findKey, *keyPtr;
+    Tcl_HashEntry *entryPtr;
+    int new;
 
-    if ((keylIntPtr->arraySize - keylIntPtr->numEntries) < newNumEntries) {
-	int newSize = keylIntPtr->arraySize + newNumEntries +
-	    KEYEDLIST_ARRAY_INCR_SIZE;
-	if (keylIntPtr->entries == NULL) {
-	    keylIntPtr->entries = (keylEntry_t *)
-		ckalloc (newSize * sizeof (keylEntry_t));
-	} else {
-	    keylIntPtr->entries = (keylEntry_t *)
-		ckrealloc ((VOID *) keylIntPtr->entries,
-			   newSize * sizeof (keylEntry_t));
-	}
-	keylIntPtr->arraySize = newSize;
+    if (!tsdPtr->initialized) {
+	Tcl_InitCustomHashTable (&tsdPtr->atomTable, TCL_CUSTOM_PTR_KEYS,
+				 &keylHashKeyType);
+	tsdPtr->initialized = TRUE;
     }
 
-    KEYL_REP_ASSERT (keylIntPtr);
+    findKey.key = (char *) key;
+    findKey.keyLen = keyLen;
+    findKey.hash = HashKeyedListKey (key, keyLen);
+
+    entryPtr = Tcl_FindHashEntry (&tsdPtr->atomTable, (char *) &findKey);
+    if (entryPtr != NULL) {
+	keyPtr = (keylKey_t *) Tcl_GetHashValue (entryPtr);
+	PreserveKeyedListKey (keyPtr);
+	return keyPtr;
+    }
+
+    keyPtr = (keylKey_t *) ckalloc (sizeof (keylKey_t) + keyLen + 1);
+    keyPtr->key = (char *) (keyPtr + 1);
+    memcpy (keyPtr->key, key, keyLen);
+    keyPtr->key [keyLen] = '\0';
+    keyPtr->keyLen = keyLen;
+    keyPtr->hash = findKey.hash;
+    keyPtr->refCount = 1;
+    keyPtr->atomEntryPtr = Tcl_CreateHashEntry (&tsdPtr->atomTable,
+						(char *) keyPtr, &new);
+    Tcl_SetHashValue (keyPtr->atomEntryPtr, (ClientData) keyPtr);
+    return keyPtr;
 }
-
+
 /*-----------------------------------------------------------------------------
- * DeleteKeyedListEntry --
- *   Delete an entry from a keyed list.
+ * ReleaseKeyedListKey --
+ *   Release a reference to a key atom, freeing it if it was the last one.
  *
  * Parameters:
- *   o keylIntPtr - Keyed list internal representation.
- *   o entryIdx - Index of entry to delete.
+ *   o keyPtr - Atom to release.
  *-----------------------------------------------------------------------------
  */
 static void
-DeleteKeyedListEntry (keylIntPtr, entryIdx)
-    keylIntObj_t *keylIntPtr;
-    int		  entryIdx;
+ReleaseKeyedListKey (keyPtr)
+    keylKey_t *keyPtr;
 {
-    int idx;
+    ThreadSpecificData *tsdPtr;
 
-#ifndef NO_KEYLIST_HASH_TABLE
-    if (keylIntPtr->hashTbl != NULL) {
-	Tcl_HashEntry *entryPtr;
-	Tcl_HashSearch search;
-	int nidx;
+    if (--keyPtr->refCount > 0)
+	return;
 
-	entryPtr = Tcl_FindHashEntry(keylIntPtr->hashTbl,
-		keylIntPtr->entries [entryIdx].key);
-	if (entryPtr != NULL) {
-	    Tcl_DeleteHashEntry(entryPtr);
-	}
+    Tcl_DeleteHashEntry (keyPtr->atomEntryPtr);
+    ckfree ((VOID *) keyPtr);
 
-	/*
-	 * In order to maintain consistency, we have to iterate over
-	 * the entire hash table to find and decr relevant idxs.
-	 * We have to do this even if the previous index was not found
-	 * in the hash table, as Dup'ing doesn't dup the hash tables.
-	 */
-	for (entryPtr = Tcl_FirstHashEntry(keylIntPtr->hashTbl, &search);
-	     entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
-	    nidx = (int) Tcl_GetHashValue(entryPtr);
-	    if (nidx > entryIdx) {
-		Tcl_SetHashValue(entryPtr, (ClientData) (nidx - 1));
-	    }
-	}
+    tsdPtr = (ThreadSpecificData *)
+	Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+    if (tsdPtr->atomTable.numEntries == 0) {
+	Tcl_DeleteHashTable (&tsdPtr->atomTable);
+	tsdPtr->initialized = FALSE;
     }
-#endif
+}
 
-    ckfree (keylIntPtr->entries [entryIdx].key);
-    Tcl_DecrRefCount(keylIntPtr->entries [entryIdx].valuePtr);
+/*-----------------------------------------------------------------------------
+ * KeylHashKeyProc --
+ *   Hash table callback to return the hash value of a keyed list key.
+ *
+ * Parameters:
+ *   o tablePtr - Hash table, not used.
+ *   o keyPtr - A pointer to a keylKey_t.
+ * Returns:
+ *    The hash value.
+ *-----------------------------------------------------------------------------
+ */
+static unsigned int
+KeylHashKeyProc (tablePtr, keyPtr)
+    Tcl_HashTable *tablePtr;
+    VOID	  *keyPtr;
+{
+    return ((keylKey_t *) keyPtr)->hash;
+}
 
-    for (idx = entryIdx; idx < keylIntPtr->numEntries - 1; idx++)
-	keylIntPtr->entries [idx] = keylIntPtr->entries [idx + 1];
-    keylIntPtr->numEntries--;
+/*-----------------------------------------------------------------------------
+ * KeylCompareKeysProc --
+ *   Hash table callback to compare a keyed list key to the key of a hash
+ * entry.
+ *
+ * Parameters:
+ *   o keyPtr - A pointer to a keylKey_t.
+ *   o hPtr - Hash entry to compare to.
+ * Returns:
+ *    TRUE if the keys are equal, FALSE if they are not.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeylCompareKeysProc (keyPtr, hPtr)
+    VOID	  *keyPtr;
+    Tcl_HashEntry *hPtr;
+{
+    keylKey_t *key1Ptr = (keylKey_t *) keyPtr;
+    keylKey_t *key2Ptr = (keylKey_t *) hPtr->key.oneWordValue;
 
-    KEYL_REP_ASSERT (keylIntPtr);
+    return (key1Ptr->keyLen == key2Ptr->keyLen) &&
+	(memcmp (key1Ptr->key, key2Ptr->key, key1Ptr->keyLen) == 0);
 }
-
+
 /*-----------------------------------------------------------------------------
- * FindKeyedListEntry --
- *   Find an entry in keyed list.
+ * AllocKeyedListPath --
+ *   Split a key path into the key atoms for each level of a keyed list.
  *
  * Parameters:
- *   o keylIntPtr - Keyed list internal representation.
- *   o key - Name of key to search for.
- *   o keyLenPtr - In not NULL, the length of the key for this
- *     level is returned here.	This excludes subkeys and the `.' delimiters.
- *   o nextSubKeyPtr - If not NULL, the start of the name of the next
- *     sub-key within key is returned.
+ *   o keyPath - Key path string.  Sub-keys are seperated by `.'.
+ *   o keyPathLen - Length of the string, or -1 if it is NUL terminated.
  * Returns:
- *   Index of the entry or -1 if not found.
+ *    A pointer to the path, with a reference count of one.
  *-----------------------------------------------------------------------------
  */
-static int
-FindKeyedListEntry (keylIntPtr, key, keyLenPtr, nextSubKeyPtr)
-    keylIntObj_t *keylIntPtr;
-    char	 *key;
-    int		 *keyLenPtr;
-    char	**nextSubKeyPtr;
+static keylPath_t *
+AllocKeyedListPath (keyPath, keyPathLen)
+    CONST char *keyPath;
+    int		keyPathLen;
 {
-    char *keySeparPtr;
-    int keyLen, findIdx = -1;
+    keylPath_t *pathPtr;
+    CONST char *keyStart;
+    int idx, numKeys;
 
-    keySeparPtr = strchr (key, '.');
-    if (keySeparPtr != NULL) {
-	keyLen = keySeparPtr - key;
-    } else {
-	keyLen = strlen (key);
+    if (keyPathLen < 0) {
+	keyPathLen = strlen (keyPath);
     }
 
-#ifndef NO_KEYLIST_HASH_TABLE
-    if (keylIntPtr->hashTbl != NULL) {
-	Tcl_HashEntry *entryPtr;
-	char tmp = key[keyLen];
-	if (keySeparPtr != NULL) {
-	    /*
-	     * A few extra guards in setting this, as if we are passed
-	     * a const char, this can crash.
-	     */
-	    key[keyLen] = '\0';
-	}
-	entryPtr = Tcl_FindHashEntry(keylIntPtr->hashTbl, key);
-	if (entryPtr != NULL) {
-	    findIdx = (int) Tcl_GetHashValue(entryPtr);
-	}
-	if (keySeparPtr != NULL) {
-	    key[keyLen] = tmp;
+    numKeys = 1;
+    for (idx = 0; idx < keyPathLen; idx++) {
+	if (keyPath [idx] == '.')
+	    numKeys++;
+    }
+
+    pathPtr = (keylPath_t *) ckalloc (sizeof (keylPath_t) +
+				      ((numKeys - 1) * sizeof (keylKey_t *)));
+    pathPtr->refCount = 1;
+    pathPtr->numKeys = 0;
+
+    keyStart = keyPath;
+    for (idx = 0; idx <= keyPathLen; idx++) {
+	if ((idx == keyPathLen) || (keyPath [idx] == '.')) {
+	    pathPtr->keys [pathPtr->numKeys++] =
+		InternKeyedListKey (keyStart, &(keyPath [idx]) - keyStart);
+	    keyStart = &(keyPath [idx + 1]);
 	}
     }
-#endif
+    return pathPtr;
+}
 
-    if (findIdx == -1) {
-	for (findIdx = 0; findIdx < keylIntPtr->numEntries; findIdx++) {
-	    if (keylIntPtr->entries [findIdx].keyLen == keyLen
-		    && STRNEQU(keylIntPtr->entries [findIdx].key, key, keyLen)) {
-		break;
-	    }
-	}
-    }
+/*-----------------------------------------------------------------------------
+ * GetKeyedListPath --
+ *   Get the split key path of an object, converting it to a key path if
+ * necessary.  The path is cached in the object, so a key is only split
+ * once.
+ *
+ * Parameters:
+ *   o keyPathPtr - Key path object.
+ * Returns:
+ *    A pointer to the path.  ReleaseKeyedListPath must be called when done
+ * with it.
+ *-----------------------------------------------------------------------------
+ */
+static keylPath_t *
+GetKeyedListPath (keyPathPtr)
+    Tcl_Obj *keyPathPtr;
+{
+    keylPath_t *pathPtr;
 
-    if (nextSubKeyPtr != NULL) {
-	if (keySeparPtr == NULL) {
-	    *nextSubKeyPtr = NULL;
-	} else {
-	    *nextSubKeyPtr = keySeparPtr + 1;
-	}
-    }
-    if (keyLenPtr != NULL) {
-	*keyLenPtr = keyLen;
+    if (keyPathPtr->typePtr != &keyedListPathType) {
+	SetKeyedListPathFromAny (NULL, keyPathPtr);
     }
+    pathPtr = (keylPath_t *) keyPathPtr->internalRep.otherValuePtr;
+    pathPtr->refCount++;
+    return pathPtr;
+}
 
-    if (findIdx >= keylIntPtr->numEntries) {
-	return -1;
-    }
+/*-----------------------------------------------------------------------------
+ * ReleaseKeyedListPath --
+ *   Release a reference to a key path, freeing it if it was the last one.
+ *
+ * Parameters:
+ *   o pathPtr - Path to release.
+ *-----------------------------------------------------------------------------
+ */
+static void
+ReleaseKeyedListPath (pathPtr)
+    keylPath_t *pathPtr;
+{
+    int idx;
 
-    return findIdx;
+    if (--pathPtr->refCount <= 0) {
+	for (idx = 0; idx < pathPtr->numKeys; idx++) {
+	    ReleaseKeyedListKey (pathPtr->keys [idx]);
+	}
+	ckfree ((VOID *) pathPtr);
+    }
 }
-
+
 /*-----------------------------------------------------------------------------
- * FreeKeyedListInternalRep --
- *   Free the internal representation of a keyed list.
+ * FreeKeyedListPathInternalRep --
+ *   Free the internal representation of a key path object.
  *
  * Parameters:
- *   o keylPtr - Keyed list object being deleted.
+ *   o keyPathPtr - Key path object being deleted.
  *-----------------------------------------------------------------------------
  */
 static void
-FreeKeyedListInternalRep (keylPtr)
-    Tcl_Obj *keylPtr;
+FreeKeyedListPathInternalRep (keyPathPtr)
+    Tcl_Obj *keyPathPtr;
 {
-    FreeKeyedListData ((keylIntObj_t *) keylPtr->internalRep.otherValuePtr);
+    ReleaseKeyedListPath ((keylPath_t *)
+			  keyPathPtr->internalRep.otherValuePtr);
 }
 
 /*-----------------------------------------------------------------------------
- * DupKeyedListInternalRep --
- *   Duplicate the internal representation of a keyed list.
+ * DupKeyedListPathInternalRep --
+ *   Duplicate the internal representation of a key path object.  Paths are
+ * never modified, so the copy shares the path.
  *
  * Parameters:
- *   o srcPtr - Keyed list object to copy.
+ *   o srcPtr - Key path object to copy.
  *   o copyPtr - Target object to copy internal representation to.
  *-----------------------------------------------------------------------------
  */
 static void
-DupKeyedListInternalRep (srcPtr, copyPtr)
+DupKeyedListPathInternalRep (srcPtr, copyPtr)
     Tcl_Obj *srcPtr;
     Tcl_Obj *copyPtr;
 {
-    keylIntObj_t *srcIntPtr =
-	(keylIntObj_t *) srcPtr->internalRep.otherValuePtr;
-    keylIntObj_t *copyIntPtr;
-    int idx;
+    keylPath_t *pathPtr = (keylPath_t *) srcPtr->internalRep.otherValuePtr;
 
-    KEYL_REP_ASSERT (srcIntPtr);
+    pathPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = (VOID *) pathPtr;
+    copyPtr->typePtr = &keyedListPathType;
+}
 
-    copyIntPtr = (keylIntObj_t *) ckalloc (sizeof (keylIntObj_t));
-    copyIntPtr->arraySize = srcIntPtr->arraySize;
-    copyIntPtr->numEntries = srcIntPtr->numEntries;
-    copyIntPtr->entries = (keylEntry_t *)
-	ckalloc (copyIntPtr->arraySize * sizeof (keylEntry_t));
-#ifndef NO_KEYLIST_HASH_TABLE
-#if 0
-    copyIntPtr->hashTbl = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(copyIntPtr->hashTbl, TCL_STRING_KEYS);
-#else
-    /*
-     * NO_KEYLIST_HASH_TABLE: We don't duplicate the hash table, so ensure
-     * that consistency checks allow for portions where not all entries are
-     * in the hash table.
-     */
-    copyIntPtr->hashTbl = NULL;
-#endif
-#endif
+/*-----------------------------------------------------------------------------
+ * SetKeyedListPathFromAny --
+ *   Convert an object to a key path from its string representation.  This
+ * never fails, keys are validated by the commands.
+ *
+ * Parameters:
+ *   o objPtr - Object to convert to a key path.
+ *-----------------------------------------------------------------------------
+ */
+static int
+SetKeyedListPathFromAny (interp, objPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *objPtr;
+{
+    keylPath_t *pathPtr;
+    char *keyPath;
+    int keyPathLen;
 
-    for (idx = 0; idx < srcIntPtr->numEntries ; idx++) {
-	copyIntPtr->entries [idx].key =
-	    ckstrdup (srcIntPtr->entries [idx].key);
-	copyIntPtr->entries [idx].keyLen = srcIntPtr->entries [idx].keyLen;
-	copyIntPtr->entries [idx].valuePtr =
-	    Tcl_DuplicateObj(srcIntPtr->entries [idx].valuePtr);
-	Tcl_IncrRefCount(copyIntPtr->entries [idx].valuePtr);
-#ifndef NO_KEYLIST_HASH_TABLE
-	/*
-	 * If we dup the hash table as well and do other better tracking
-	 * of all access, then we could remove the entries list.
-	 */
-#endif
+    keyPath = Tcl_GetStringFromObj (objPtr, &keyPathLen);
+    pathPtr = AllocKeyedListPath (keyPath, keyPathLen);
+
+    if ((objPtr->typePtr != NULL) &&
+	(objPtr->typePtr->freeIntRepProc != NULL)) {
+	(*objPtr->typePtr->freeIntRepProc) (objPtr);
     }
+    objPtr->internalRep.otherValuePtr = (VOID *) pathPtr;
+    objPtr->typePtr = &keyedListPathType;
+    return TCL_OK;
+}
 
-    copyPtr->internalRep.otherValuePtr = (VOID *) copyIntPtr;
-    copyPtr->typePtr = &keyedListType;
+/*-----------------------------------------------------------------------------
+ * AllocKeyedListIntRep --
+ *   Allocate an and initialize the keyed list internal representation.
+ *
+ * Returns:
+ *    A pointer to the keyed list internal structure.
+ *-----------------------------------------------------------------------------
+ */
+static keylIntObj_t *
+AllocKeyedListIntRep ()
+{
+    keylIntObj_t *keylIntPtr;
 
-    KEYL_REP_ASSERT (copyIntPtr);
+    keylIntPtr = (keylIntObj_t *) ckalloc (sizeof (keylIntObj_t));
+    memset(keylIntPtr, 0, sizeof (keylIntObj_t));
+    return keylIntPtr;
 }
 
 /*-----------------------------------------------------------------------------
- * SetKeyedListFromAny --
- *   Convert an object to a keyed list from its string representation.	Only
- * the first level is converted, as there is no way of knowing how far down
- * the keyed list recurses until lower levels are accessed.
+ * FreeKeyedListData --
+ *   Free the internal representation of a keyed list.
  *
  * Parameters:
- *   o objPtr - Object to convert to a keyed list.
+ *   o keylIntPtr - Keyed list internal structure to free.
  *-----------------------------------------------------------------------------
  */
-static int
-SetKeyedListFromAny (interp, objPtr) 
-    Tcl_Interp *interp;
-    Tcl_Obj    *objPtr;
-{
+static void
+FreeKeyedListData (keylIntPtr)
     keylIntObj_t *keylIntPtr;
-    keylEntry_t *keyEntryPtr;
-    char *key;
-    int keyLen, idx, objc, subObjc;
-    Tcl_Obj **objv, **subObjv;
+{
+    int idx;
+
+    for (idx = 0; idx < keylIntPtr->numSlots ; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr == NULL)
+	    continue;
+	Tcl_DecrRefCount(keylIntPtr->entries [idx].valuePtr);
+	InvalidateKeyedListEntryString (&(keylIntPtr->entries [idx]));
+    }
 #ifndef NO_KEYLIST_HASH_TABLE
-    int dummy;
-    Tcl_HashEntry *entryPtr;
+    if (keylIntPtr->hashTbl != NULL) {
+	Tcl_DeleteHashTable(keylIntPtr->hashTbl);
+	ckfree((char *) (keylIntPtr->hashTbl));
+    }
 #endif
-
-    if (Tcl_ListObjGetElements (interp, objPtr, &objc, &objv) != TCL_OK) {
-	return TCL_ERROR;
+    /*
+     * The hash table keys are the entry keys, so they are released last.
+     */
+    for (idx = 0; idx < keylIntPtr->numSlots ; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr != NULL)
+	    ReleaseKeyedListKey (keylIntPtr->entries [idx].keyPtr);
     }
+    if (keylIntPtr->entries != NULL)
+	ckfree ((VOID*) keylIntPtr->entries);
+    ckfree ((VOID*) keylIntPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * EnsureKeyedListSpace --
+ *   Ensure there is enough room in a keyed list array for a certain number
+ * of entries, expanding if necessary.  The array at least doubles in size
+ * when it is expanded, unless a larger number of entries is requested, in
+ * which case exactly that many are allocated.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *   o newNumEntries - The number of entries that are going to be added to
+ *     the keyed list.
+ *-----------------------------------------------------------------------------
+ */
+static void
+EnsureKeyedListSpace (keylIntPtr, newNumEntries)
+    keylIntObj_t *keylIntPtr;
+    int		  newNumEntries;
+{
+    KEYL_REP_ASSERT (keylIntPtr);
 
-    keylIntPtr = AllocKeyedListIntRep();
-
-    EnsureKeyedListSpace(keylIntPtr, objc);
-
-    for (idx = 0; idx < objc; idx++) {
-	if ((Tcl_ListObjGetElements(interp, objv[idx],
-		     &subObjc, &subObjv) != TCL_OK)
-		|| (subObjc != 2)) {
-	    Tcl_ResetResult(interp);
-	    Tcl_AppendStringsToObj(Tcl_GetObjResult (interp),
-		    "keyed list entry must be a valid, 2 element list, got \"",
-		    Tcl_GetString(objv[idx]), "\"", (char *) NULL);
-	    FreeKeyedListData(keylIntPtr);
-	    return TCL_ERROR;
-	}
+    if ((keylIntPtr->arraySize - keylIntPtr->numSlots) < newNumEntries) {
+	int newSize = keylIntPtr->arraySize * 2;
 
-	key = Tcl_GetStringFromObj(subObjv[0], &keyLen);
-	if (ValidateKey(interp, key, keyLen) == TCL_ERROR) {
-	    FreeKeyedListData (keylIntPtr);
-	    return TCL_ERROR;
-	}
-	/*
-	 * When setting from a random list/string, we cannot allow
-	 * keys to have embedded '.' path separators
-	 */
-	if ((strchr(key, '.') != NULL)) {
-	    Tcl_AppendStringsToObj (Tcl_GetObjResult (interp),
-		    "keyed list key may not contain a \".\"; ",
-		    "it is used as a separator in key paths",
-		    (char *) NULL);
-	    FreeKeyedListData (keylIntPtr);
-	    return TCL_ERROR;
+	if (newSize < KEYEDLIST_ARRAY_MIN_SIZE)
+	    newSize = KEYEDLIST_ARRAY_MIN_SIZE;
+	if (newSize < keylIntPtr->numSlots + newNumEntries)
+	    newSize = keylIntPtr->numSlots + newNumEntries;
+	if (keylIntPtr->entries == NULL) {
+	    keylIntPtr->entries = (keylEntry_t *)
+		ckalloc (newSize * sizeof (keylEntry_t));
+	} else {
+	    keylIntPtr->entries = (keylEntry_t *)
+		ckrealloc ((VOID *) keylIntPtr->entries,
+			   newSize * sizeof (keylEntry_t));
 	}
-	keyEntryPtr = &(keylIntPtr->entries[idx]);
+	keylIntPtr->arraySize = newSize;
+    }
 
-	keyEntryPtr->key = ckstrdup(key);
-	keyEntryPtr->keyLen = keyLen;
-	keyEntryPtr->valuePtr = Tcl_DuplicateObj(subObjv[1]);
-	Tcl_IncrRefCount(keyEntryPtr->valuePtr);
+    KEYL_REP_ASSERT (keylIntPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * EnsureKeyedListHashTable --
+ *   Build the hash table index of a keyed list if it doesn't have one and
+ * it has grown large enough to benefit from it.  Once built, the table is
+ * kept up to date by all operations that modify the entries.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *-----------------------------------------------------------------------------
+ */
 #ifndef NO_KEYLIST_HASH_TABLE
+static void
+EnsureKeyedListHashTable (keylIntPtr)
+    keylIntObj_t *keylIntPtr;
+{
+    Tcl_HashEntry *entryPtr;
+    int idx, dummy;
+
+    if ((keylIntPtr->hashTbl != NULL) ||
+	    (keylIntPtr->numEntries < KEYEDLIST_HASH_THRESHOLD)) {
+	return;
+    }
+
+    keylIntPtr->hashTbl = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+    Tcl_InitHashTable(keylIntPtr->hashTbl, TCL_ONE_WORD_KEYS);
+
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr == NULL)
+	    continue;
 	entryPtr = Tcl_CreateHashEntry(keylIntPtr->hashTbl,
-		keyEntryPtr->key, &dummy);
+		(char *) keylIntPtr->entries [idx].keyPtr, &dummy);
 	Tcl_SetHashValue(entryPtr, (ClientData) idx);
+    }
+}
 #endif
 
-	keylIntPtr->numEntries++;
+/*-----------------------------------------------------------------------------
+ * CompactKeyedList --
+ *   Squeeze the deleted slots out of a keyed list array, preserving the
+ * order of the remaining entries and updating the hash table to match.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *-----------------------------------------------------------------------------
+ */
+static void
+CompactKeyedList (keylIntPtr)
+    keylIntObj_t *keylIntPtr;
+{
+    int idx, newIdx = 0;
+
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr == NULL)
+	    continue;
+	if (idx != newIdx) {
+	    keylIntPtr->entries [newIdx] = keylIntPtr->entries [idx];
+#ifndef NO_KEYLIST_HASH_TABLE
+	    if (keylIntPtr->hashTbl != NULL) {
+		Tcl_HashEntry *entryPtr;
+
+		entryPtr = Tcl_FindHashEntry(keylIntPtr->hashTbl,
+			(char *) keylIntPtr->entries [newIdx].keyPtr);
+		Tcl_SetHashValue(entryPtr, (ClientData) newIdx);
+	    }
+#endif
+	}
+	newIdx++;
     }
+    keylIntPtr->numSlots = newIdx;
 
-    if ((objPtr->typePtr != NULL) &&
-	(objPtr->typePtr->freeIntRepProc != NULL)) {
-	(*objPtr->typePtr->freeIntRepProc) (objPtr);
+    KEYL_REP_ASSERT (keylIntPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * AddKeyedListEntry --
+ *   Add an entry to the end of a keyed list.  The key must not already be
+ * in the keyed list.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *   o keyPtr - Key atom of the entry, a reference to it is added.
+ *   o valuePtr - Value of the entry, its reference count is incremented.
+ * Returns:
+ *   The index of the new entry.
+ *-----------------------------------------------------------------------------
+ */
+static int
+AddKeyedListEntry (keylIntPtr, keyPtr, valuePtr)
+    keylIntObj_t *keylIntPtr;
+    keylKey_t	 *keyPtr;
+    Tcl_Obj	 *valuePtr;
+{
+    keylEntry_t *entryPtr;
+    int entryIdx;
+
+    EnsureKeyedListSpace (keylIntPtr, 1);
+    entryIdx = keylIntPtr->numSlots++;
+    keylIntPtr->numEntries++;
+
+    entryPtr = &(keylIntPtr->entries [entryIdx]);
+    entryPtr->keyPtr = keyPtr;
+    PreserveKeyedListKey (keyPtr);
+    entryPtr->valuePtr = valuePtr;
+    Tcl_IncrRefCount(valuePtr);
+    entryPtr->stringPtr = NULL;
+
+#ifndef NO_KEYLIST_HASH_TABLE
+    if (keylIntPtr->hashTbl != NULL) {
+	Tcl_HashEntry *hashEntryPtr;
+	int dummy;
+
+	hashEntryPtr = Tcl_CreateHashEntry(keylIntPtr->hashTbl,
+		(char *) entryPtr->keyPtr, &dummy);
+	Tcl_SetHashValue(hashEntryPtr, (ClientData) entryIdx);
     }
-    objPtr->internalRep.otherValuePtr = (VOID *) keylIntPtr;
-    objPtr->typePtr = &keyedListType;
+#endif
+    return entryIdx;
+}
+
+/*-----------------------------------------------------------------------------
+ * DeleteKeyedListEntry --
+ *   Delete an entry from a keyed list.  The slot is left empty, the array is
+ * compacted once the empty slots outnumber the entries, so the cost of a
+ * delete is constant when amortized over a series of deletes.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *   o entryIdx - Index of entry to delete.
+ *-----------------------------------------------------------------------------
+ */
+static void
+DeleteKeyedListEntry (keylIntPtr, entryIdx)
+    keylIntObj_t *keylIntPtr;
+    int		  entryIdx;
+{
+    int numDeleted;
+
+#ifndef NO_KEYLIST_HASH_TABLE
+    if (keylIntPtr->hashTbl != NULL) {
+	Tcl_HashEntry *entryPtr;
+
+	entryPtr = Tcl_FindHashEntry(keylIntPtr->hashTbl,
+		(char *) keylIntPtr->entries [entryIdx].keyPtr);
+	if (entryPtr != NULL) {
+	    Tcl_DeleteHashEntry(entryPtr);
+	}
+    }
+#endif
+
+    ReleaseKeyedListKey (keylIntPtr->entries [entryIdx].keyPtr);
+    Tcl_DecrRefCount(keylIntPtr->entries [entryIdx].valuePtr);
+    InvalidateKeyedListEntryString (&(keylIntPtr->entries [entryIdx]));
+    keylIntPtr->entries [entryIdx].keyPtr = NULL;
+    keylIntPtr->entries [entryIdx].valuePtr = NULL;
+    keylIntPtr->numEntries--;
+
+    /*
+     * Empty slots at the end of the array can just be dropped.
+     */
+    while ((keylIntPtr->numSlots > 0) &&
+	   (keylIntPtr->entries [keylIntPtr->numSlots - 1].keyPtr == NULL)) {
+	keylIntPtr->numSlots--;
+    }
+
+    numDeleted = keylIntPtr->numSlots - keylIntPtr->numEntries;
+    if ((numDeleted >= KEYEDLIST_COMPACT_MIN_SIZE) &&
+	(numDeleted > keylIntPtr->numEntries)) {
+	CompactKeyedList (keylIntPtr);
+    }
+
+    KEYL_REP_ASSERT (keylIntPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * GetKeyedListEntryString --
+ *   Get the string of a keyed list entry, formatted as an element of the
+ * string of its keyed list.  The string is cached in the entry until the
+ * entry is modified.
+ *
+ * Parameters:
+ *   o entryPtr - Keyed list entry to get the string of.
+ *   o lengthPtr - The length of the string is returned here.
+ * Returns:
+ *   A pointer to the string.
+ *-----------------------------------------------------------------------------
+ */
+static char *
+GetKeyedListEntryString (entryPtr, lengthPtr)
+    keylEntry_t *entryPtr;
+    int		*lengthPtr;
+{
+    Tcl_Obj *entryObjv [2], *tmpListObj;
+    char *listStr;
+    int listLen, flags;
+
+    if (entryPtr->stringPtr != NULL) {
+	return Tcl_GetStringFromObj (entryPtr->stringPtr, lengthPtr);
+    }
+
+    /*
+     * Format the entry as a two element list, then quote that as a list
+     * element.  The key is the first element of the entry, so the entry
+     * string never starts with a `#' and quotes the same in any position.
+     */
+    entryObjv [0] = Tcl_NewStringObj (entryPtr->keyPtr->key,
+				      entryPtr->keyPtr->keyLen);
+    entryObjv [1] = entryPtr->valuePtr;
+    tmpListObj = Tcl_NewListObj (2, entryObjv);
+    Tcl_IncrRefCount(tmpListObj);
+    listStr = Tcl_GetStringFromObj (tmpListObj, &listLen);
+
+    entryPtr->stringPtr = Tcl_NewObj ();
+    Tcl_IncrRefCount(entryPtr->stringPtr);
+    Tcl_SetObjLength (entryPtr->stringPtr,
+		      Tcl_ScanCountedElement (listStr, listLen, &flags));
+    Tcl_SetObjLength (entryPtr->stringPtr,
+		      Tcl_ConvertCountedElement (listStr, listLen,
+			      Tcl_GetString (entryPtr->stringPtr), flags));
+    Tcl_DecrRefCount(tmpListObj);
+
+    return Tcl_GetStringFromObj (entryPtr->stringPtr, lengthPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * FindKeyedListEntry --
+ *   Find an entry in keyed list.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *   o keyPtr - Key atom to search for, a single level of a key path.
+ * Returns:
+ *   Index of the entry or -1 if not found.
+ *-----------------------------------------------------------------------------
+ */
+static int
+FindKeyedListEntry (keylIntPtr, keyPtr)
+    keylIntObj_t *keylIntPtr;
+    keylKey_t	 *keyPtr;
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+    int findIdx;
+
+#ifndef NO_KEYLIST_HASH_TABLE
+    EnsureKeyedListHashTable (keylIntPtr);
+    if (keylIntPtr->hashTbl != NULL) {
+	Tcl_HashEntry *entryPtr;
+
+	tsdPtr->hashLookups++;
+	entryPtr = Tcl_FindHashEntry(keylIntPtr->hashTbl, (char *) keyPtr);
+	if (entryPtr == NULL) {
+	    return -1;
+	}
+	return (int) Tcl_GetHashValue(entryPtr);
+    }
+#endif
+
+    tsdPtr->linearScans++;
+    for (findIdx = 0; findIdx < keylIntPtr->numSlots; findIdx++) {
+	if (keylIntPtr->entries [findIdx].keyPtr == keyPtr) {
+	    tsdPtr->scannedSlots += findIdx + 1;
+	    return findIdx;
+	}
+    }
+    tsdPtr->scannedSlots += keylIntPtr->numSlots;
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ * FreeKeyedListInternalRep --
+ *   Free the internal representation of a keyed list.
+ *
+ * Parameters:
+ *   o keylPtr - Keyed list object being deleted.
+ *-----------------------------------------------------------------------------
+ */
+static void
+FreeKeyedListInternalRep (keylPtr)
+    Tcl_Obj *keylPtr;
+{
+    FreeKeyedListData ((keylIntObj_t *) keylPtr->internalRep.otherValuePtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * DupKeyedListInternalRep --
+ *   Duplicate the internal representation of a keyed list.  Only the top
+ * level is copied, the entry values are shared with the source and are
+ * copied by DupSharedKeyListChild when a sub-key path is modified.
+ *
+ * Parameters:
+ *   o srcPtr - Keyed list object to copy.
+ *   o copyPtr - Target object to copy internal representation to.
+ *-----------------------------------------------------------------------------
+ */
+static void
+DupKeyedListInternalRep (srcPtr, copyPtr)
+    Tcl_Obj *srcPtr;
+    Tcl_Obj *copyPtr;
+{
+    keylIntObj_t *srcIntPtr =
+	(keylIntObj_t *) srcPtr->internalRep.otherValuePtr;
+    keylIntObj_t *copyIntPtr;
+    keylEntry_t *srcEntryPtr, *copyEntryPtr;
+    int idx;
+
+    KEYL_REP_ASSERT (srcIntPtr);
+
+    /*
+     * Deleted slots are not copied, so the copy starts out compacted.
+     */
+    copyIntPtr = (keylIntObj_t *) ckalloc (sizeof (keylIntObj_t));
+    copyIntPtr->arraySize = srcIntPtr->arraySize;
+    copyIntPtr->numSlots = srcIntPtr->numEntries;
+    copyIntPtr->numEntries = srcIntPtr->numEntries;
+    copyIntPtr->entries = (keylEntry_t *)
+	ckalloc (copyIntPtr->arraySize * sizeof (keylEntry_t));
+#ifndef NO_KEYLIST_HASH_TABLE
+    /*
+     * The hash table is not copied, it is rebuilt by the first lookup on the
+     * copy.  Copies that are only stringified or discarded never pay for
+     * an index they don't use.
+     */
+    copyIntPtr->hashTbl = NULL;
+#endif
+
+    copyEntryPtr = copyIntPtr->entries;
+    for (idx = 0; idx < srcIntPtr->numSlots ; idx++) {
+	srcEntryPtr = &(srcIntPtr->entries [idx]);
+	if (srcEntryPtr->keyPtr == NULL)
+	    continue;
+	copyEntryPtr->keyPtr = srcEntryPtr->keyPtr;
+	PreserveKeyedListKey (copyEntryPtr->keyPtr);
+	copyEntryPtr->valuePtr = srcEntryPtr->valuePtr;
+	Tcl_IncrRefCount(copyEntryPtr->valuePtr);
+	copyEntryPtr->stringPtr = srcEntryPtr->stringPtr;
+	if (copyEntryPtr->stringPtr != NULL) {
+	    Tcl_IncrRefCount(copyEntryPtr->stringPtr);
+	}
+	copyEntryPtr++;
+    }
+
+    copyPtr->internalRep.otherValuePtr = (VOID *) copyIntPtr;
+    copyPtr->typePtr = &keyedListType;
+
+    KEYL_REP_ASSERT (copyIntPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * SetKeyedListFromAny --
+ *   Convert an object to a keyed list from its string representation.	Only
+ * the first level is converted, as there is no way of knowing how far down
+ * the keyed list recurses until lower levels are accessed.
+ *
+ * Parameters:
+ *   o objPtr - Object to convert to a keyed list.
+ *-----------------------------------------------------------------------------
+ */
+static int
+SetKeyedListFromAny (interp, objPtr) 
+    Tcl_Interp *interp;
+    Tcl_Obj    *objPtr;
+{
+    keylIntObj_t *keylIntPtr;
+    keylKey_t *keyPtr;
+    char *key;
+    int idx, keyLen, objc, subObjc;
+    Tcl_Obj **objv, **subObjv;
+
+    if (Tcl_ListObjGetElements (interp, objPtr, &objc, &objv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    keylIntPtr = AllocKeyedListIntRep();
+
+    EnsureKeyedListSpace(keylIntPtr, objc);
+
+    for (idx = 0; idx < objc; idx++) {
+	if ((Tcl_ListObjGetElements(interp, objv[idx],
+		     &subObjc, &subObjv) != TCL_OK)
+		|| (subObjc != 2)) {
+	    Tcl_ResetResult(interp);
+	    Tcl_AppendStringsToObj(Tcl_GetObjResult (interp),
+		    "keyed list entry must be a valid, 2 element list, got \"",
+		    Tcl_GetString(objv[idx]), "\"", (char *) NULL);
+	    FreeKeyedListData(keylIntPtr);
+	    return TCL_ERROR;
+	}
+
+	key = Tcl_GetStringFromObj(subObjv[0], &keyLen);
+	if (ValidateEntryKey(interp, key, keyLen) == TCL_ERROR) {
+	    FreeKeyedListData (keylIntPtr);
+	    return TCL_ERROR;
+	}
+	keyPtr = InternKeyedListKey (key, keyLen);
+	AddKeyedListEntry (keylIntPtr, keyPtr, subObjv[1]);
+	ReleaseKeyedListKey (keyPtr);
+    }
+
+    if ((objPtr->typePtr != NULL) &&
+	(objPtr->typePtr->freeIntRepProc != NULL)) {
+	(*objPtr->typePtr->freeIntRepProc) (objPtr);
+    }
+    objPtr->internalRep.otherValuePtr = (VOID *) keylIntPtr;
+    objPtr->typePtr = &keyedListType;
+
+    KEYL_REP_ASSERT (keylIntPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * UpdateStringOfKeyedList --
+ *    Update the string representation of a keyed list.
+ *
+ * Parameters:
+ *   o objPtr - Object to convert to a keyed list.
+ *-----------------------------------------------------------------------------
+ */
+static void
+UpdateStringOfKeyedList (keylPtr)
+    Tcl_Obj  *keylPtr;
+{
+    int idx, strLen, entryLen;
+    char *entryStr, *strPtr;
+    keylIntObj_t *keylIntPtr =
+	(keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+    /*
+     * The string is the entry strings separated by spaces.  Each entry is
+     * formatted via a list object to support binary data, but only when it
+     * has changed since its string was last generated.
+     */
+    strLen = 0;
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr == NULL)
+	    continue;
+	GetKeyedListEntryString (&(keylIntPtr->entries [idx]), &entryLen);
+	strLen += entryLen + 1;
+    }
+    if (strLen > 0)
+	strLen--;
+
+    keylPtr->bytes = ckalloc (strLen + 1);
+    keylPtr->length = strLen;
+
+    strPtr = keylPtr->bytes;
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	if (keylIntPtr->entries [idx].keyPtr == NULL)
+	    continue;
+	if (strPtr != keylPtr->bytes)
+	    *strPtr++ = ' ';
+	entryStr = GetKeyedListEntryString (&(keylIntPtr->entries [idx]),
+					    &entryLen);
+	memcpy (strPtr, entryStr, entryLen);
+	strPtr += entryLen;
+    }
+    *strPtr = '\0';
+}
+
+/*-----------------------------------------------------------------------------
+ * KeyedListGet --
+ *   Retrieve a key value from a keyed list given a split key path.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to get key from.
+ *   o pathPtr - The key path to retrieve.
+ *   o valueObjPtrPtr - If the key is found, a pointer to the key object
+ *     is returned here.  NULL is returned if the key is not present.
+ * Returns:
+ *   o TCL_OK - If the key value was returned.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeyedListGet (interp, keylPtr, pathPtr, valuePtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    keylPath_t *pathPtr;
+    Tcl_Obj   **valuePtrPtr;
+{
+    keylIntObj_t *keylIntPtr;
+    int keyIdx, findIdx;
+
+    for (keyIdx = 0; keyIdx < pathPtr->numKeys; keyIdx++) {
+	if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	    return TCL_ERROR;
+	keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+	KEYL_REP_ASSERT (keylIntPtr);
+
+	findIdx = FindKeyedListEntry (keylIntPtr, pathPtr->keys [keyIdx]);
+
+	/*
+	 * If not found, return status.
+	 */
+	if (findIdx < 0) {
+	    *valuePtrPtr = NULL;
+	    return TCL_BREAK;
+	}
+	keylPtr = keylIntPtr->entries [findIdx].valuePtr;
+    }
+    *valuePtrPtr = keylPtr;
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * KeyedListSet --
+ *   Set a key value in keyed list object given a split key path.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result object.
+ *   o keylPtr - Keyed list object to update.
+ *   o pathPtr - The key path to set.
+ *   o keyIdx - Index in the path of the key for this level of the keyed list.
+ *   o valueObjPtr - The value to set for the key.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeyedListSet (interp, keylPtr, pathPtr, keyIdx, valuePtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    keylPath_t *pathPtr;
+    int		keyIdx;
+    Tcl_Obj    *valuePtr;
+{
+    keylIntObj_t *keylIntPtr;
+    keylEntry_t *keyEntryPtr;
+    keylKey_t *keyPtr = pathPtr->keys [keyIdx];
+    int findIdx, status = TCL_OK;
+    Tcl_Obj *newKeylPtr;
+
+    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	return TCL_ERROR;
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+    KEYL_REP_ASSERT (keylIntPtr);
+
+    findIdx = FindKeyedListEntry (keylIntPtr, keyPtr);
+
+    /*
+     * If we are at the last subkey, either update or add an entry.
+     */
+    if (keyIdx == pathPtr->numKeys - 1) {
+	if (findIdx < 0) {
+	    AddKeyedListEntry (keylIntPtr, keyPtr, valuePtr);
+	} else {
+	    keyEntryPtr = &(keylIntPtr->entries [findIdx]);
+	    Tcl_IncrRefCount(valuePtr);
+	    Tcl_DecrRefCount(keyEntryPtr->valuePtr);
+	    keyEntryPtr->valuePtr = valuePtr;
+	    InvalidateKeyedListEntryString (keyEntryPtr);
+	}
+	Tcl_InvalidateStringRep (keylPtr);
+
+	KEYL_REP_ASSERT (keylIntPtr);
+	return TCL_OK;
+    }
+
+    /*
+     * If we are not at the last subkey, recurse down, creating new
+     * entries if neccessary.  If this level key was not found, it
+     * means we must build new subtree. Don't insert the new tree until we
+     * come back without error.
+     */
+    if (findIdx >= 0) {
+	DupSharedKeyListChild (keylIntPtr, findIdx);
+	status = KeyedListSet (interp,
+			       keylIntPtr->entries [findIdx].valuePtr,
+			       pathPtr, keyIdx + 1, valuePtr);
+	if (status == TCL_OK) {
+	    InvalidateKeyedListEntryString (&(keylIntPtr->entries [findIdx]));
+	    Tcl_InvalidateStringRep (keylPtr);
+	}
+    } else {
+	newKeylPtr = TclX_NewKeyedListObj ();
+	Tcl_IncrRefCount(newKeylPtr);
+	if (KeyedListSet (interp, newKeylPtr, pathPtr, keyIdx + 1,
+			  valuePtr) != TCL_OK) {
+	    Tcl_DecrRefCount(newKeylPtr);
+	    return TCL_ERROR;
+	}
+	AddKeyedListEntry (keylIntPtr, keyPtr, newKeylPtr);
+	Tcl_DecrRefCount(newKeylPtr);
+	Tcl_InvalidateStringRep (keylPtr);
+    }
+
+    KEYL_REP_ASSERT (keylIntPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * CheckKeyedListPairs --
+ *   Check that a series of keys and values can all be set in a keyed list.
+ * Setting a sub-key fails if the value of a key on its path is not a keyed
+ * list, which may only be found after the earlier keys have been set.  The
+ * keys that are on the path of a sub-key, other than that of the first pair,
+ * are set in a scratch keyed list holding just those keys, so the keyed list
+ * itself is not copied.  If all of them can be set, so can all of the pairs
+ * be set in the keyed list.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to check, already converted to a keyed list.
+ *   o pairc - Number of objects in pairv.
+ *   o pairv - Alternating keys and values.  The keys have been validated.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+CheckKeyedListPairs (interp, keylPtr, pairc, pairv)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    int		pairc;
+    Tcl_Obj   **pairv;
+{
+    keylIntObj_t *keylIntPtr, *scratchIntPtr;
+    keylPath_t *pathPtr;
+    keylKey_t *keyPtr;
+    Tcl_HashTable keyTable;
+    Tcl_HashEntry *hashEntryPtr;
+    Tcl_HashSearch search;
+    Tcl_Obj *scratchPtr;
+    int idx, findIdx, isNew, status = TCL_OK;
+
+    /*
+     * Find the keys on the path of a sub-key.  If the first pair fails,
+     * nothing has been set yet, so it need not be checked.
+     */
+    if (pairc <= 2)
+	return TCL_OK;
+    Tcl_InitHashTable (&keyTable, TCL_ONE_WORD_KEYS);
+    for (idx = 2; idx < pairc; idx += 2) {
+	pathPtr = GetKeyedListPath (pairv [idx]);
+	if (pathPtr->numKeys > 1)
+	    Tcl_CreateHashEntry (&keyTable, (char *) pathPtr->keys [0], &isNew);
+	ReleaseKeyedListPath (pathPtr);
+    }
+    if (keyTable.numEntries == 0) {
+	Tcl_DeleteHashTable (&keyTable);
+	return TCL_OK;
+    }
+
+    /*
+     * The scratch list shares the values of the keyed list.  They are copied
+     * before being modified, as they are shared.
+     */
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+    scratchPtr = TclX_NewKeyedListObj ();
+    Tcl_IncrRefCount (scratchPtr);
+    scratchIntPtr = (keylIntObj_t *) scratchPtr->internalRep.otherValuePtr;
+    for (hashEntryPtr = Tcl_FirstHashEntry (&keyTable, &search);
+	 hashEntryPtr != NULL; hashEntryPtr = Tcl_NextHashEntry (&search)) {
+	keyPtr = (keylKey_t *) Tcl_GetHashKey (&keyTable, hashEntryPtr);
+	findIdx = FindKeyedListEntry (keylIntPtr, keyPtr);
+	if (findIdx >= 0)
+	    AddKeyedListEntry (scratchIntPtr, keyPtr,
+			       keylIntPtr->entries [findIdx].valuePtr);
+    }
+
+    for (idx = 0; idx < pairc; idx += 2) {
+	pathPtr = GetKeyedListPath (pairv [idx]);
+	if (Tcl_FindHashEntry (&keyTable, (char *) pathPtr->keys [0]) != NULL)
+	    status = KeyedListSet (interp, scratchPtr, pathPtr, 0,
+				   pairv [idx + 1]);
+	ReleaseKeyedListPath (pathPtr);
+	if (status != TCL_OK)
+	    break;
+    }
+
+    Tcl_DecrRefCount (scratchPtr);
+    Tcl_DeleteHashTable (&keyTable);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * KeyedListDelete --
+ *   Delete a key value from keyed list given a split key path.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to update.
+ *   o pathPtr - The key path to delete.
+ *   o keyIdx - Index in the path of the key for this level of the keyed list.
+ * Returns:
+ *   o TCL_OK - If the key was deleted.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeyedListDelete (interp, keylPtr, pathPtr, keyIdx)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    keylPath_t *pathPtr;
+    int		keyIdx;
+{
+    keylIntObj_t *keylIntPtr, *subKeylIntPtr;
+    int findIdx, status;
+
+    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	return TCL_ERROR;
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+    findIdx = FindKeyedListEntry (keylIntPtr, pathPtr->keys [keyIdx]);
+
+    /*
+     * If not found, return status.
+     */
+    if (findIdx < 0) {
+	KEYL_REP_ASSERT (keylIntPtr);
+	return TCL_BREAK;
+    }
+
+    /*
+     * If we are at the last subkey, delete the entry.
+     */
+    if (keyIdx == pathPtr->numKeys - 1) {
+	DeleteKeyedListEntry (keylIntPtr, findIdx);
+	Tcl_InvalidateStringRep (keylPtr);
+
+	KEYL_REP_ASSERT (keylIntPtr);
+	return TCL_OK;
+    }
+
+    /*
+     * If we are not at the last subkey, recurse down.	If the entry is
+     * deleted and the sub-keyed list is empty, delete it as well.  Must
+     * invalidate string, as it caches all representations below it.
+     */
+    DupSharedKeyListChild (keylIntPtr, findIdx);
+
+    status = KeyedListDelete (interp,
+			      keylIntPtr->entries [findIdx].valuePtr,
+			      pathPtr, keyIdx + 1);
+    if (status == TCL_OK) {
+	subKeylIntPtr = (keylIntObj_t *)
+	    keylIntPtr->entries [findIdx].valuePtr->internalRep.otherValuePtr;
+	if (subKeylIntPtr->numEntries == 0) {
+	    DeleteKeyedListEntry (keylIntPtr, findIdx);
+	} else {
+	    InvalidateKeyedListEntryString (&(keylIntPtr->entries [findIdx]));
+	}
+	Tcl_InvalidateStringRep (keylPtr);
+    }
+
+    KEYL_REP_ASSERT (keylIntPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * KeyedListGetKeys --
+ *   Retrieve a list of keyed list keys given a split key path.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to get key from.
+ *   o pathPtr - The key path to get the sub keys for.  NULL to retrieve all
+ *     top level keys.
+ *   o listObjPtrPtr - List object is returned here with key as values.
+ * Returns:
+ *   o TCL_OK - If the zero or more key where returned.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeyedListGetKeys (interp, keylPtr, pathPtr, listObjPtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    keylPath_t *pathPtr;
+    Tcl_Obj   **listObjPtrPtr;
+{
+    keylIntObj_t *keylIntPtr;
+    Tcl_Obj *listObjPtr;
+    int idx, status;
+
+    /*
+     * If a key path was given, find the keyed list it references.
+     */
+    if (pathPtr != NULL) {
+	status = KeyedListGet (interp, keylPtr, pathPtr, &keylPtr);
+	if (status != TCL_OK)
+	    return status;
+    }
+
+    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	return TCL_ERROR;
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+    listObjPtr = Tcl_NewObj();
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	if (keylIntPtr->entries[idx].keyPtr == NULL)
+	    continue;
+	Tcl_ListObjAppendElement(interp, listObjPtr,
+		Tcl_NewStringObj(keylIntPtr->entries[idx].keyPtr->key,
+			keylIntPtr->entries[idx].keyPtr->keyLen));
+    }
+    *listObjPtrPtr = listObjPtr;
+    KEYL_REP_ASSERT (keylIntPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_NewKeyedListObj --
+ *   Create and initialize a new keyed list object.
+ *
+ * Returns:
+ *    A pointer to the object.
+ *-----------------------------------------------------------------------------
+ */
+Tcl_Obj *
+TclX_NewKeyedListObj ()
+{
+    return TclX_NewSizedKeyedListObj (0);
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_NewSizedKeyedListObj --
+ *   Create and initialize a new keyed list object, with room for a number of
+ * entries allocated up front.
+ *
+ * Parameters:
+ *   o numEntries - The number of entries the keyed list is expected to hold.
+ *     This is only a hint, the keyed list grows as needed.
+ * Returns:
+ *    A pointer to the object.
+ *-----------------------------------------------------------------------------
+ */
+Tcl_Obj *
+TclX_NewSizedKeyedListObj (numEntries)
+    int numEntries;
+{
+    Tcl_Obj *keylPtr = Tcl_NewObj ();
+    keylIntObj_t *keylIntPtr = AllocKeyedListIntRep ();
+
+    if (numEntries > 0) {
+	keylIntPtr->entries = (keylEntry_t *)
+	    ckalloc (numEntries * sizeof (keylEntry_t));
+	keylIntPtr->arraySize = numEntries;
+    }
+    keylPtr->internalRep.otherValuePtr = (VOID *) keylIntPtr;
+    keylPtr->typePtr = &keyedListType;
+    return keylPtr;
+}
+
+#if (TCL_MAJOR_VERSION > 8) || (TCL_MINOR_VERSION >= 5)
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListToDict --
+ *   Convert a keyed list to a dict.  The value objects are shared with the
+ * keyed list, they are not copied or converted to strings.  Only the top
+ * level is converted, subfield values are passed through unchanged, so the
+ * result depends only on the string of the keyed list.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to convert.
+ *   o dictPtrPtr - The new dict object is returned here.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListToDict (interp, keylPtr, dictPtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    Tcl_Obj   **dictPtrPtr;
+{
+    keylIntObj_t *keylIntPtr;
+    keylEntry_t *entryPtr;
+    Tcl_Obj *dictPtr;
+    int idx;
+
+    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	return TCL_ERROR;
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+    dictPtr = Tcl_NewDictObj ();
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	entryPtr = &(keylIntPtr->entries [idx]);
+	if (entryPtr->keyPtr == NULL)
+	    continue;
+	Tcl_DictObjPut (interp, dictPtr,
+			Tcl_NewStringObj (entryPtr->keyPtr->key,
+					  entryPtr->keyPtr->keyLen),
+			entryPtr->valuePtr);
+    }
+    *dictPtrPtr = dictPtr;
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_DictToKeyedList --
+ *   Convert a dict to a keyed list.  The value objects are shared with the
+ * dict, they are not copied or converted to strings.  Only the top level is
+ * converted, values that are themselves dicts are passed through unchanged,
+ * so the result depends only on the string of the dict.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o dictPtr - Dict object to convert.
+ *   o keylPtrPtr - The new keyed list object is returned here.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_DictToKeyedList (interp, dictPtr, keylPtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *dictPtr;
+    Tcl_Obj   **keylPtrPtr;
+{
+    keylIntObj_t *keylIntPtr;
+    keylKey_t *keyPtr;
+    Tcl_DictSearch search;
+    Tcl_Obj *keylPtr, *keyObjPtr, *valuePtr;
+    char *key;
+    int keyLen, numEntries, done;
+
+    if (Tcl_DictObjSize (interp, dictPtr, &numEntries) != TCL_OK)
+	return TCL_ERROR;
+
+    keylPtr = TclX_NewSizedKeyedListObj (numEntries);
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+    Tcl_DictObjFirst (interp, dictPtr, &search, &keyObjPtr, &valuePtr, &done);
+    for (; !done; Tcl_DictObjNext (&search, &keyObjPtr, &valuePtr, &done)) {
+	key = Tcl_GetStringFromObj (keyObjPtr, &keyLen);
+	if (ValidateEntryKey (interp, key, keyLen) == TCL_ERROR)
+	    goto errorExit;
+
+	keyPtr = InternKeyedListKey (key, keyLen);
+	AddKeyedListEntry (keylIntPtr, keyPtr, valuePtr);
+	ReleaseKeyedListKey (keyPtr);
+    }
+    Tcl_DictObjDone (&search);
+#ifndef NO_KEYLIST_HASH_TABLE
+    EnsureKeyedListHashTable (keylIntPtr);
+#endif
+    Tcl_InvalidateStringRep (keylPtr);
+
+    KEYL_REP_ASSERT (keylIntPtr);
+    *keylPtrPtr = keylPtr;
+    return TCL_OK;
+
+  errorExit:
+    Tcl_DictObjDone (&search);
+    Tcl_DecrRefCount (keylPtr);
+    return TCL_ERROR;
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListGet --
+ *   Retrieve a key value from a keyed list.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to get key from.
+ *   o key - The name of the key to extract.  Will recusively process sub-keys
+ *     seperated by `.'.
+ *   o valueObjPtrPtr - If the key is found, a pointer to the key object
+ *     is returned here.  NULL is returned if the key is not present.
+ * Returns:
+ *   o TCL_OK - If the key value was returned.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListGet (interp, keylPtr, key, valuePtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    char       *key;
+    Tcl_Obj   **valuePtrPtr;
+{
+    keylPath_t *pathPtr;
+    int status;
+
+    pathPtr = AllocKeyedListPath (key, -1);
+    status = KeyedListGet (interp, keylPtr, pathPtr, valuePtrPtr);
+    ReleaseKeyedListPath (pathPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListSet --
+ *   Set a key value in keyed list object.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result object.
+ *   o keylPtr - Keyed list object to update.
+ *   o key - The name of the key to extract.  Will recursively process
+ *     sub-key seperated by `.'.
+ *   o valueObjPtr - The value to set for the key.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListSet (interp, keylPtr, key, valuePtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    char       *key;
+    Tcl_Obj    *valuePtr;
+{
+    keylPath_t *pathPtr;
+    int status;
+
+    pathPtr = AllocKeyedListPath (key, -1);
+    status = KeyedListSet (interp, keylPtr, pathPtr, 0, valuePtr);
+    ReleaseKeyedListPath (pathPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListDelete --
+ *   Delete a key value from keyed list.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to update.
+ *   o key - The name of the key to extract.  Will recusively process
+ *     sub-key seperated by `.'.
+ * Returns:
+ *   o TCL_OK - If the key was deleted.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListDelete (interp, keylPtr, key)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    char       *key;
+{
+    keylPath_t *pathPtr;
+    int status;
+
+    pathPtr = AllocKeyedListPath (key, -1);
+    status = KeyedListDelete (interp, keylPtr, pathPtr, 0);
+    ReleaseKeyedListPath (pathPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListGetKeys --
+ *   Retrieve a list of keyed list keys.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to get key from.
+ *   o key - The name of the key to get the sub keys for.  NULL or empty
+ *     to retrieve all top level keys.
+ *   o listObjPtrPtr - List object is returned here with key as values.
+ * Returns:
+ *   o TCL_OK - If the zero or more key where returned.
+ *   o TCL_BREAK - If the key was not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListGetKeys (interp, keylPtr, key, listObjPtrPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    char       *key;
+    Tcl_Obj   **listObjPtrPtr;
+{
+    keylPath_t *pathPtr;
+    int status;
+
+    if ((key == NULL) || (key [0] == '\0')) {
+	return KeyedListGetKeys (interp, keylPtr, NULL, listObjPtrPtr);
+    }
+    pathPtr = AllocKeyedListPath (key, -1);
+    status = KeyedListGetKeys (interp, keylPtr, pathPtr, listObjPtrPtr);
+    ReleaseKeyedListPath (pathPtr);
+    return status;
+}
+
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListGetMany --
+ *   Retrieve the values of several keys from a keyed list.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result if there is an error.
+ *   o keylPtr - Keyed list object to get keys from.
+ *   o numKeys - Number of keys to retrieve.
+ *   o keys - The names of the keys to extract.  Will recusively process
+ *     sub-keys seperated by `.'.
+ *   o valuePtrs - An array of numKeys entries.  A pointer to the value
+ *     object of each key that is found is returned here, NULL is returned
+ *     for each key that is not present.
+ * Returns:
+ *   o TCL_OK - If all of the key values were returned.
+ *   o TCL_BREAK - If one or more of the keys were not found.
+ *   o TCL_ERROR - If an error occured.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListGetMany (interp, keylPtr, numKeys, keys, valuePtrs)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    int		numKeys;
+    char      **keys;
+    Tcl_Obj   **valuePtrs;
+{
+    keylPath_t *pathPtr;
+    int idx, status, result = TCL_OK;
+
+    for (idx = 0; idx < numKeys; idx++) {
+	pathPtr = AllocKeyedListPath (keys [idx], -1);
+	status = KeyedListGet (interp, keylPtr, pathPtr, &(valuePtrs [idx]));
+	ReleaseKeyedListPath (pathPtr);
+	if (status == TCL_ERROR)
+	    return TCL_ERROR;
+	if (status == TCL_BREAK)
+	    result = TCL_BREAK;
+    }
+    return result;
+}
 
-    KEYL_REP_ASSERT (keylIntPtr);
+/*-----------------------------------------------------------------------------
+ * TclX_KeyedListSetMany --
+ *   Set the values of several keys in keyed list object.
+ *
+ * Parameters:
+ *   o interp - Error message will be return in result object.
+ *   o keylPtr - Keyed list object to update.
+ *   o numKeys - Number of keys to set.
+ *   o keys - The names of the keys to set.  Will recursively process
+ *     sub-key seperated by `.'.
+ *   o valuePtrs - The values to set for each of the keys.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclX_KeyedListSetMany (interp, keylPtr, numKeys, keys, valuePtrs)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    int		numKeys;
+    char      **keys;
+    Tcl_Obj   **valuePtrs;
+{
+    keylPath_t *pathPtr;
+    int idx, status;
+
+    for (idx = 0; idx < numKeys; idx++) {
+	pathPtr = AllocKeyedListPath (keys [idx], -1);
+	status = KeyedListSet (interp, keylPtr, pathPtr, 0, valuePtrs [idx]);
+	ReleaseKeyedListPath (pathPtr);
+	if (status != TCL_OK)
+	    return status;
+    }
     return TCL_OK;
 }
-
+
 /*-----------------------------------------------------------------------------
- * UpdateStringOfKeyedList --
- *    Update the string representation of a keyed list.
+ * TclX_KeyedListSetPairs --
+ *   Set the keys and values from a flat key/value list in a keyed list
+ * object.  Room for all of the new entries is allocated at once and the
+ * entries and their index are built in a single pass over the list.  All of
+ * the entries are checked before the keyed list is modified, so on an error
+ * the keyed list is not modified.
  *
  * Parameters:
- *   o objPtr - Object to convert to a keyed list.
+ *   o interp - Error message will be return in result object.
+ *   o keylPtr - Keyed list object to update.
+ *   o pairListPtr - List of alternating keys and values.  The keys will
+ *     recursively process sub-key seperated by `.'.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
  *-----------------------------------------------------------------------------
  */
-static void
-UpdateStringOfKeyedList (keylPtr)
-    Tcl_Obj  *keylPtr;
+int
+TclX_KeyedListSetPairs (interp, keylPtr, pairListPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *keylPtr;
+    Tcl_Obj    *pairListPtr;
 {
-#define UPDATE_STATIC_SIZE 32
-    int idx, strLen;
-    Tcl_Obj **listObjv, *entryObjv [2], *tmpListObj;
-    Tcl_Obj *staticListObjv [UPDATE_STATIC_SIZE];
-    char *listStr;
-    keylIntObj_t *keylIntPtr =
-	(keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+    keylIntObj_t *keylIntPtr;
+    keylPath_t *pathPtr;
+    Tcl_Obj **pairv;
+    char *key;
+    int idx, pairc, keyLen, status;
 
-    /*
-     * Conversion to strings is done via list objects to support binary data.
-     */
-    if (keylIntPtr->numEntries > UPDATE_STATIC_SIZE) {
-	listObjv =
-	    (Tcl_Obj **) ckalloc (keylIntPtr->numEntries * sizeof (Tcl_Obj *));
-    } else {
-	listObjv = staticListObjv;
+    if (Tcl_ListObjGetElements (interp, pairListPtr, &pairc,
+				&pairv) != TCL_OK)
+	return TCL_ERROR;
+    if ((pairc % 2) != 0) {
+	Tcl_SetStringObj (Tcl_GetObjResult (interp),
+	      "keyed list key/value list must have an even number of elements",
+			  -1);
+	return TCL_ERROR;
     }
-
-    /*
-     * Convert each keyed list entry to a two element list object.  No
-     * need to incr/decr ref counts, the list objects will take care of that.
-     * FIX: Keeping key as string object will speed this up.
-     */
-    for (idx = 0; idx < keylIntPtr->numEntries; idx++) {
-	entryObjv [0] = 
-	    Tcl_NewStringObj (keylIntPtr->entries [idx].key,
-		    keylIntPtr->entries [idx].keyLen);
-	entryObjv [1] = keylIntPtr->entries [idx].valuePtr;
-	listObjv [idx] = Tcl_NewListObj (2, entryObjv);
+    for (idx = 0; idx < pairc; idx += 2) {
+	key = Tcl_GetStringFromObj (pairv [idx], &keyLen);
+	if (ValidateKey (interp, key, keyLen) == TCL_ERROR)
+	    return TCL_ERROR;
     }
 
-    tmpListObj = Tcl_NewListObj (keylIntPtr->numEntries, listObjv);
-    Tcl_IncrRefCount(tmpListObj);
-    listStr = Tcl_GetStringFromObj (tmpListObj, &strLen);
-    keylPtr->bytes = ckbinstrdup (listStr, strLen);
-    keylPtr->length = strLen;
-    Tcl_DecrRefCount(tmpListObj);
+    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+	return TCL_ERROR;
+    if (CheckKeyedListPairs (interp, keylPtr, pairc, pairv) != TCL_OK)
+	return TCL_ERROR;
 
-    if (listObjv != staticListObjv)
-	ckfree ((VOID*) listObjv);
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+    EnsureKeyedListSpace (keylIntPtr, pairc / 2);
+
+    for (idx = 0; idx < pairc; idx += 2) {
+	pathPtr = GetKeyedListPath (pairv [idx]);
+	status = KeyedListSet (interp, keylPtr, pathPtr, 0, pairv [idx + 1]);
+	ReleaseKeyedListPath (pathPtr);
+	if (status != TCL_OK)
+	    return status;
+    }
+    return TCL_OK;
 }
-
+
 /*-----------------------------------------------------------------------------
- * TclX_NewKeyedListObj --
- *   Create and initialize a new keyed list object.
+ * PutSerialInt --
+ *   Append a 32 bit unsigned integer to a serialized keyed list, most
+ * significant byte first.
  *
- * Returns:
- *    A pointer to the object.
+ * Parameters:
+ *   o dataPtr - Dynamic string containing the serialized data.
+ *   o value - Value to append.
  *-----------------------------------------------------------------------------
  */
-Tcl_Obj *
-TclX_NewKeyedListObj ()
+static void
+PutSerialInt (dataPtr, value)
+    Tcl_DString  *dataPtr;
+    unsigned int  value;
 {
-    Tcl_Obj *keylPtr = Tcl_NewObj ();
-    keylIntObj_t *keylIntPtr = AllocKeyedListIntRep ();
+    char buf [4];
 
-    keylPtr->internalRep.otherValuePtr = (VOID *) keylIntPtr;
-    keylPtr->typePtr = &keyedListType;
-    return keylPtr;
+    buf [0] = (char) ((value >> 24) & 0xFF);
+    buf [1] = (char) ((value >> 16) & 0xFF);
+    buf [2] = (char) ((value >> 8) & 0xFF);
+    buf [3] = (char) (value & 0xFF);
+    Tcl_DStringAppend (dataPtr, buf, 4);
 }
-
+
 /*-----------------------------------------------------------------------------
- * TclX_KeyedListGet --
- *   Retrieve a key value from a keyed list.
+ * GetSerialInt --
+ *   Extract a 32 bit unsigned integer from a serialized keyed list.
  *
  * Parameters:
- *   o interp - Error message will be return in result if there is an error.
- *   o keylPtr - Keyed list object to get key from.
- *   o key - The name of the key to extract.  Will recusively process sub-keys
- *     seperated by `.'.
- *   o valueObjPtrPtr - If the key is found, a pointer to the key object
- *     is returned here.  NULL is returned if the key is not present.
+ *   o dataPtrPtr - Pointer to the current position in the data, advanced
+ *     past the integer.
+ *   o endPtr - End of the data.
+ *   o valuePtr - The value is returned here.
  * Returns:
- *   o TCL_OK - If the key value was returned.
- *   o TCL_BREAK - If the key was not found.
- *   o TCL_ERROR - If an error occured.
+ *   TRUE if the integer was extracted, FALSE if the data is truncated.
  *-----------------------------------------------------------------------------
  */
-int
-TclX_KeyedListGet (interp, keylPtr, key, valuePtrPtr)
-    Tcl_Interp *interp;
-    Tcl_Obj    *keylPtr;
-    char       *key;
-    Tcl_Obj   **valuePtrPtr;
+static int
+GetSerialInt (dataPtrPtr, endPtr, valuePtr)
+    unsigned char **dataPtrPtr;
+    unsigned char  *endPtr;
+    unsigned int   *valuePtr;
 {
+    unsigned char *dataPtr = *dataPtrPtr;
+
+    if ((endPtr - dataPtr) < 4)
+	return FALSE;
+    *valuePtr = (((unsigned int) dataPtr [0]) << 24) |
+	(((unsigned int) dataPtr [1]) << 16) |
+	(((unsigned int) dataPtr [2]) << 8) |
+	((unsigned int) dataPtr [3]);
+    *dataPtrPtr = dataPtr + 4;
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ * SerializeKeyedList --
+ *   Append the binary serialization of a keyed list internal representation
+ * to a dynamic string.  Values that are keyed list objects are serialized
+ * recursively, other values are stored as their string.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation to serialize.
+ *   o dataPtr - Dynamic string to append the serialized data to.
+ *-----------------------------------------------------------------------------
+ */
+static void
+SerializeKeyedList (keylIntPtr, dataPtr)
     keylIntObj_t *keylIntPtr;
-    char *nextSubKey;
-    int findIdx;
+    Tcl_DString  *dataPtr;
+{
+    keylEntry_t *entryPtr;
+    char *value;
+    int idx, valueLen;
 
-    while (1) {
-	if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
-	    return TCL_ERROR;
-	keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
-	KEYL_REP_ASSERT (keylIntPtr);
+    PutSerialInt (dataPtr, (unsigned int) keylIntPtr->numEntries);
 
-	findIdx = FindKeyedListEntry(keylIntPtr, key, NULL, &nextSubKey);
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	entryPtr = &(keylIntPtr->entries [idx]);
+	if (entryPtr->keyPtr == NULL)
+	    continue;
 
-	/*
-	 * If not found, return status.
-	 */
-	if (findIdx < 0) {
-	    *valuePtrPtr = NULL;
-	    return TCL_BREAK;
-	}
+	PutSerialInt (dataPtr, (unsigned int) entryPtr->keyPtr->keyLen);
+	Tcl_DStringAppend (dataPtr, entryPtr->keyPtr->key,
+			   entryPtr->keyPtr->keyLen);
 
-	/*
-	 * If we are at the last subkey, return the entry, otherwise recurse
-	 * down looking for the entry.
-	 */
-	if (nextSubKey == NULL) {
-	    *valuePtrPtr = keylIntPtr->entries [findIdx].valuePtr;
-	    return TCL_OK;
+	if (entryPtr->valuePtr->typePtr == &keyedListType) {
+	    Tcl_DStringAppend (dataPtr, KEYL_SERIAL_KEYED_LIST, 1);
+	    SerializeKeyedList ((keylIntObj_t *)
+				entryPtr->valuePtr->internalRep.otherValuePtr,
+				dataPtr);
 	} else {
-	    keylPtr = keylIntPtr->entries [findIdx].valuePtr;
-	    key = nextSubKey;
+	    Tcl_DStringAppend (dataPtr, KEYL_SERIAL_STRING, 1);
+	    value = Tcl_GetStringFromObj (entryPtr->valuePtr, &valueLen);
+	    PutSerialInt (dataPtr, (unsigned int) valueLen);
+	    Tcl_DStringAppend (dataPtr, value, valueLen);
 	}
     }
 }
-
+
 /*-----------------------------------------------------------------------------
- * TclX_KeyedListSet --
- *   Set a key value in keyed list object.
+ * DeserializeKeyedList --
+ *   Build a keyed list object from its binary serialization.  The internal
+ * representation of the keyed list and all nested keyed lists, including
+ * their hash table indexes, are built directly from the data.
  *
  * Parameters:
- *   o interp - Error message will be return in result object.
- *   o keylPtr - Keyed list object to update.
- *   o key - The name of the key to extract.  Will recursively process
- *     sub-key seperated by `.'.
- *   o valueObjPtr - The value to set for the key.
+ *   o interp - Error message will be return in result if there is an error.
+ *   o dataPtrPtr - Pointer to the current position in the data, advanced
+ *     past the keyed list.
+ *   o endPtr - End of the data.
+ *   o depth - Nesting depth of this keyed list.
  * Returns:
- *   TCL_OK or TCL_ERROR.
+ *   The new keyed list object, with a reference count of zero, or NULL if
+ * an error occured.
  *-----------------------------------------------------------------------------
  */
-int
-TclX_KeyedListSet (interp, keylPtr, key, valuePtr)
-    Tcl_Interp *interp;
-    Tcl_Obj    *keylPtr;
-    char       *key;
-    Tcl_Obj    *valuePtr;
+static Tcl_Obj *
+DeserializeKeyedList (interp, dataPtrPtr, endPtr, depth)
+    Tcl_Interp     *interp;
+    unsigned char **dataPtrPtr;
+    unsigned char  *endPtr;
+    int		    depth;
 {
+    Tcl_Obj *keylPtr, *valuePtr;
     keylIntObj_t *keylIntPtr;
-    keylEntry_t *keyEntryPtr;
-    char *nextSubKey;
-    int findIdx, keyLen, status = TCL_OK;
-    Tcl_Obj *newKeylPtr;
-
-    while (1) {
-	if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
-	    return TCL_ERROR;
-	keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
-	KEYL_REP_ASSERT (keylIntPtr);
+    keylKey_t *keyPtr;
+    unsigned char *dataPtr = *dataPtrPtr;
+    unsigned int numEntries, keyLen, valueLen;
+    char *key;
+    int idx;
 
-	findIdx = FindKeyedListEntry (keylIntPtr, key, &keyLen, &nextSubKey);
+    /*
+     * An entry is at least 10 bytes, don't trust a count that claims more
+     * entries than the data can hold.
+     */
+    if ((depth > KEYL_SERIAL_MAX_DEPTH) ||
+	    !GetSerialInt (&dataPtr, endPtr, &numEntries) ||
+	    (numEntries > (unsigned int) (endPtr - dataPtr) / 10)) {
+	goto invalidData;
+    }
 
-	/*
-	 * If we are at the last subkey, either update or add an entry.
-	 */
-	if (nextSubKey == NULL) {
-#ifndef NO_KEYLIST_HASH_TABLE
-	    int dummy;
-	    Tcl_HashEntry *entryPtr;
-#endif
-	    if (findIdx < 0) {
-		EnsureKeyedListSpace (keylIntPtr, 1);
-		findIdx = keylIntPtr->numEntries++;
-	    } else {
-		ckfree (keylIntPtr->entries [findIdx].key);
-		Tcl_DecrRefCount(keylIntPtr->entries [findIdx].valuePtr);
-	    }
-	    keyEntryPtr = &(keylIntPtr->entries[findIdx]);
-	    keyEntryPtr->key = (char *) ckalloc (keyLen + 1);
-	    memcpy(keyEntryPtr->key, key, keyLen);
-	    keyEntryPtr->key[keyLen] = '\0';
-	    keyEntryPtr->keyLen      = keyLen;
-	    keyEntryPtr->valuePtr    = valuePtr;
-	    Tcl_IncrRefCount(valuePtr);
-#ifndef NO_KEYLIST_HASH_TABLE
-	    if (keylIntPtr->hashTbl == NULL) {
-		keylIntPtr->hashTbl =
-		    (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-		Tcl_InitHashTable(keylIntPtr->hashTbl, TCL_STRING_KEYS);
-	    }
-	    entryPtr = Tcl_CreateHashEntry(keylIntPtr->hashTbl,
-		    keyEntryPtr->key, &dummy);
-	    Tcl_SetHashValue(entryPtr, (ClientData) findIdx);
-#endif
-	    Tcl_InvalidateStringRep (keylPtr);
+    keylPtr = TclX_NewSizedKeyedListObj ((int) numEntries);
+    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
 
-	    KEYL_REP_ASSERT (keylIntPtr);
-	    return TCL_OK;
+    for (idx = 0; idx < (int) numEntries; idx++) {
+	if (!GetSerialInt (&dataPtr, endPtr, &keyLen) ||
+		(keyLen >= (unsigned int) (endPtr - dataPtr))) {
+	    goto freeAndInvalidData;
+	}
+	key = (char *) dataPtr;
+	dataPtr += keyLen;
+	if ((keyLen == 0) || (memchr (key, '\0', keyLen) != NULL) ||
+		(memchr (key, '.', keyLen) != NULL)) {
+	    goto freeAndInvalidData;
 	}
 
-	/*
-	 * If we are not at the last subkey, recurse down, creating new
-	 * entries if neccessary.  If this level key was not found, it
-	 * means we must build new subtree. Don't insert the new tree until we
-	 * come back without error.
-	 */
-	if (findIdx >= 0) {
-	    DupSharedKeyListChild (keylIntPtr, findIdx);
-	    status = TclX_KeyedListSet (interp,
-		    keylIntPtr->entries [findIdx].valuePtr,
-		    nextSubKey, valuePtr);
-	    if (status == TCL_OK) {
-		Tcl_InvalidateStringRep (keylPtr);
-	    }
-	} else {
-#ifndef NO_KEYLIST_HASH_TABLE
-	    int dummy;
-	    Tcl_HashEntry *entryPtr;
-#endif
-	    newKeylPtr = TclX_NewKeyedListObj ();
-	    Tcl_IncrRefCount(newKeylPtr);
-	    if (TclX_KeyedListSet (interp, newKeylPtr,
-			nextSubKey, valuePtr) != TCL_OK) {
-		Tcl_DecrRefCount(newKeylPtr);
-		return TCL_ERROR;
+	if (*dataPtr == KEYL_SERIAL_KEYED_LIST [0]) {
+	    dataPtr++;
+	    valuePtr = DeserializeKeyedList (interp, &dataPtr, endPtr,
+					     depth + 1);
+	    if (valuePtr == NULL) {
+		Tcl_DecrRefCount (keylPtr);
+		return NULL;
 	    }
-	    EnsureKeyedListSpace (keylIntPtr, 1);
-	    findIdx = keylIntPtr->numEntries++;
-	    keyEntryPtr = &(keylIntPtr->entries[findIdx]);
-	    keyEntryPtr->key = (char *) ckalloc (keyLen + 1);
-	    memcpy(keyEntryPtr->key, key, keyLen);
-	    keyEntryPtr->key[keyLen] = '\0';
-	    keyEntryPtr->keyLen      = keyLen;
-	    keyEntryPtr->valuePtr    = newKeylPtr;
-#ifndef NO_KEYLIST_HASH_TABLE
-	    if (keylIntPtr->hashTbl == NULL) {
-		keylIntPtr->hashTbl =
-		    (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
-		Tcl_InitHashTable(keylIntPtr->hashTbl, TCL_STRING_KEYS);
+	} else if (*dataPtr == KEYL_SERIAL_STRING [0]) {
+	    dataPtr++;
+	    if (!GetSerialInt (&dataPtr, endPtr, &valueLen) ||
+		    (valueLen > (unsigned int) (endPtr - dataPtr))) {
+		goto freeAndInvalidData;
 	    }
-	    entryPtr = Tcl_CreateHashEntry(keylIntPtr->hashTbl,
-		    keyEntryPtr->key, &dummy);
-	    Tcl_SetHashValue(entryPtr, (ClientData) findIdx);
-#endif
-	    Tcl_InvalidateStringRep (keylPtr);
+	    valuePtr = Tcl_NewStringObj ((char *) dataPtr, (int) valueLen);
+	    dataPtr += valueLen;
+	} else {
+	    goto freeAndInvalidData;
 	}
 
-	KEYL_REP_ASSERT (keylIntPtr);
-	return status;
+	keyPtr = InternKeyedListKey (key, (int) keyLen);
+	if (FindKeyedListEntry (keylIntPtr, keyPtr) >= 0) {
+	    ReleaseKeyedListKey (keyPtr);
+	    Tcl_DecrRefCount (valuePtr);
+	    goto freeAndInvalidData;
+	}
+	AddKeyedListEntry (keylIntPtr, keyPtr, valuePtr);
+	ReleaseKeyedListKey (keyPtr);
     }
+#ifndef NO_KEYLIST_HASH_TABLE
+    EnsureKeyedListHashTable (keylIntPtr);
+#endif
+    Tcl_InvalidateStringRep (keylPtr);
+
+    KEYL_REP_ASSERT (keylIntPtr);
+    *dataPtrPtr = dataPtr;
+    return keylPtr;
+
+  freeAndInvalidData:
+    Tcl_DecrRefCount (keylPtr);
+  invalidData:
+    TclX_AppendObjResult (interp, "invalid serialized keyed list",
+			  (char *) NULL);
+    return NULL;
 }
-
+
 /*-----------------------------------------------------------------------------
- * TclX_KeyedListDelete --
- *   Delete a key value from keyed list.
+ * TclX_KeyedListSerialize --
+ *   Serialize a keyed list into a compact binary form, which can be turned
+ * back into a keyed list by TclX_KeyedListDeserialize.
  *
  * Parameters:
  *   o interp - Error message will be return in result if there is an error.
- *   o keylPtr - Keyed list object to update.
- *   o key - The name of the key to extract.  Will recusively process
- *     sub-key seperated by `.'.
+ *   o keylPtr - Keyed list object to serialize.
+ *   o dataPtrPtr - A byte array object containing the serialized keyed list
+ *     is returned here.
  * Returns:
- *   o TCL_OK - If the key was deleted.
- *   o TCL_BREAK - If the key was not found.
- *   o TCL_ERROR - If an error occured.
+ *   TCL_OK or TCL_ERROR.
  *-----------------------------------------------------------------------------
  */
 int
-TclX_KeyedListDelete (interp, keylPtr, key)
+TclX_KeyedListSerialize (interp, keylPtr, dataPtrPtr)
     Tcl_Interp *interp;
     Tcl_Obj    *keylPtr;
-    char       *key;
+    Tcl_Obj   **dataPtrPtr;
 {
-    keylIntObj_t *keylIntPtr, *subKeylIntPtr;
-    char *nextSubKey;
-    int findIdx, status;
+    Tcl_DString data;
 
     if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
 	return TCL_ERROR;
-    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
-
-    findIdx = FindKeyedListEntry (keylIntPtr, key, NULL, &nextSubKey);
-
-    /*
-     * If not found, return status.
-     */
-    if (findIdx < 0) {
-	KEYL_REP_ASSERT (keylIntPtr);
-	return TCL_BREAK;
-    }
-
-    /*
-     * If we are at the last subkey, delete the entry.
-     */
-    if (nextSubKey == NULL) {
-	DeleteKeyedListEntry (keylIntPtr, findIdx);
-	Tcl_InvalidateStringRep (keylPtr);
-
-	KEYL_REP_ASSERT (keylIntPtr);
-	return TCL_OK;
-    }
-
-    /*
-     * If we are not at the last subkey, recurse down.	If the entry is
-     * deleted and the sub-keyed list is empty, delete it as well.  Must
-     * invalidate string, as it caches all representations below it.
-     */
-    DupSharedKeyListChild (keylIntPtr, findIdx);
 
-    status = TclX_KeyedListDelete (interp,
-				   keylIntPtr->entries [findIdx].valuePtr,
-				   nextSubKey);
-    if (status == TCL_OK) {
-	subKeylIntPtr = (keylIntObj_t *)
-	    keylIntPtr->entries [findIdx].valuePtr->internalRep.otherValuePtr;
-	if (subKeylIntPtr->numEntries == 0) {
-	    DeleteKeyedListEntry (keylIntPtr, findIdx);
-	}
-	Tcl_InvalidateStringRep (keylPtr);
-    }
+    Tcl_DStringInit (&data);
+    Tcl_DStringAppend (&data, KEYL_SERIAL_MAGIC, KEYL_SERIAL_MAGIC_LEN);
+    SerializeKeyedList ((keylIntObj_t *) keylPtr->internalRep.otherValuePtr,
+			&data);
 
-    KEYL_REP_ASSERT (keylIntPtr);
-    return status;
+    *dataPtrPtr = Tcl_NewByteArrayObj ((unsigned char *)
+				       Tcl_DStringValue (&data),
+				       Tcl_DStringLength (&data));
+    Tcl_DStringFree (&data);
+    return TCL_OK;
 }
-
+
 /*-----------------------------------------------------------------------------
- * TclX_KeyedListGetKeys --
- *   Retrieve a list of keyed list keys.
+ * TclX_KeyedListDeserialize --
+ *   Create a keyed list from the binary form produced by
+ * TclX_KeyedListSerialize.
  *
  * Parameters:
  *   o interp - Error message will be return in result if there is an error.
- *   o keylPtr - Keyed list object to get key from.
- *   o key - The name of the key to get the sub keys for.  NULL or empty
- *     to retrieve all top level keys.
- *   o listObjPtrPtr - List object is returned here with key as values.
+ *   o dataPtr - Byte array object containing the serialized keyed list.
+ *   o keylPtrPtr - The new keyed list object is returned here.
  * Returns:
- *   o TCL_OK - If the zero or more key where returned.
- *   o TCL_BREAK - If the key was not found.
- *   o TCL_ERROR - If an error occured.
+ *   TCL_OK or TCL_ERROR.
  *-----------------------------------------------------------------------------
  */
 int
-TclX_KeyedListGetKeys (interp, keylPtr, key, listObjPtrPtr)
+TclX_KeyedListDeserialize (interp, dataPtr, keylPtrPtr)
     Tcl_Interp *interp;
-    Tcl_Obj    *keylPtr;
-    char       *key;
-    Tcl_Obj   **listObjPtrPtr;
+    Tcl_Obj    *dataPtr;
+    Tcl_Obj   **keylPtrPtr;
 {
-    keylIntObj_t *keylIntPtr;
-    Tcl_Obj *listObjPtr;
-    char *nextSubKey;
-    int idx, findIdx;
+    Tcl_Obj *keylPtr;
+    unsigned char *bytesPtr, *endPtr;
+    int bytesLen;
 
-    if (Tcl_ConvertToType (interp, keylPtr, &keyedListType) != TCL_OK)
+    bytesPtr = Tcl_GetByteArrayFromObj (dataPtr, &bytesLen);
+    endPtr = bytesPtr + bytesLen;
+
+    if ((bytesLen < KEYL_SERIAL_MAGIC_LEN) ||
+	    (memcmp (bytesPtr, KEYL_SERIAL_MAGIC, KEYL_SERIAL_MAGIC_LEN) != 0)) {
+	TclX_AppendObjResult (interp, "invalid serialized keyed list",
+			      (char *) NULL);
+	return TCL_ERROR;
+    }
+    bytesPtr += KEYL_SERIAL_MAGIC_LEN;
+
+    keylPtr = DeserializeKeyedList (interp, &bytesPtr, endPtr, 0);
+    if (keylPtr == NULL)
 	return TCL_ERROR;
-    keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+    if (bytesPtr != endPtr) {
+	Tcl_DecrRefCount (keylPtr);
+	TclX_AppendObjResult (interp, "invalid serialized keyed list",
+			      (char *) NULL);
+	return TCL_ERROR;
+    }
+    *keylPtrPtr = keylPtr;
+    return TCL_OK;
+}
 
-    /*
-     * If key is not NULL or empty, then recurse down until we go past
-     * the end of all of the elements of the key.
-     */
-    if ((key != NULL) && (key [0] != '\0')) {
-	findIdx = FindKeyedListEntry (keylIntPtr, key, NULL, &nextSubKey);
-	if (findIdx < 0) {
-	    TclX_Assert (keylIntPtr->arraySize >= keylIntPtr->numEntries);
-	    return TCL_BREAK;
+/*-----------------------------------------------------------------------------
+ * KeylgetVarsCmd --
+ *   Implements the multiple key form of the keylget command:
+ *	   keylget listvar key retvar ?key retvar ...?
+ *   Each value is returned in its variable and a list of flags indicating
+ * which keys were found is returned as the result.
+ *-----------------------------------------------------------------------------
+ */
+static int
+KeylgetVarsCmd (interp, keylPtr, objc, objv)
+    Tcl_Interp	*interp;
+    Tcl_Obj	*keylPtr;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *valuePtr, *resultPtr;
+    keylPath_t *pathPtr;
+    char *key;
+    int idx, keyLen, status;
+
+    for (idx = 2; idx < objc; idx += 2) {
+	key = Tcl_GetStringFromObj (objv [idx], &keyLen);
+	if (ValidateKey(interp, key, keyLen) == TCL_ERROR) {
+	    return TCL_ERROR;
 	}
-	TclX_Assert (keylIntPtr->arraySize >= keylIntPtr->numEntries);
-	return TclX_KeyedListGetKeys (interp, 
-				      keylIntPtr->entries [findIdx].valuePtr,
-				      nextSubKey,
-				      listObjPtrPtr);
     }
 
     /*
-     * Reached the end of the full key, return all keys at this level.
+     * Setting a variable may run a trace that modifies listvar, so hold on to
+     * the keyed list that the values come from.
      */
-    listObjPtr = Tcl_NewObj();
-    for (idx = 0; idx < keylIntPtr->numEntries; idx++) {
-	Tcl_ListObjAppendElement(interp, listObjPtr,
-		Tcl_NewStringObj(keylIntPtr->entries[idx].key,
-			keylIntPtr->entries[idx].keyLen));
+    Tcl_IncrRefCount (keylPtr);
+    resultPtr = Tcl_NewObj ();
+
+    for (idx = 2; idx < objc; idx += 2) {
+	pathPtr = GetKeyedListPath (objv [idx]);
+	status = KeyedListGet (interp, keylPtr, pathPtr, &valuePtr);
+	ReleaseKeyedListPath (pathPtr);
+	if (status == TCL_ERROR)
+	    goto errorExit;
+
+	if ((status == TCL_OK) && !TclX_IsNullObj (objv [idx + 1]) &&
+		(Tcl_ObjSetVar2 (interp, objv [idx + 1], NULL, valuePtr,
+				 TCL_LEAVE_ERR_MSG) == NULL)) {
+	    goto errorExit;
+	}
+	Tcl_ListObjAppendElement (interp, resultPtr,
+				  Tcl_NewBooleanObj (status == TCL_OK));
     }
-    *listObjPtrPtr = listObjPtr;
-    TclX_Assert (keylIntPtr->arraySize >= keylIntPtr->numEntries);
+
+    Tcl_DecrRefCount (keylPtr);
+    Tcl_SetObjResult (interp, resultPtr);
     return TCL_OK;
+
+  errorExit:
+    Tcl_DecrRefCount (keylPtr);
+    Tcl_DecrRefCount (resultPtr);
+    return TCL_ERROR;
 }
-
+
 /*-----------------------------------------------------------------------------
  * Tcl_KeylgetObjCmd --
  *     Implements the TCL keylget command:
- *	   keylget listvar ?key? ?retvar | {}?
+ *	   keylget listvar ?key? ?retvar | {}? ?key retvar ...?
  *-----------------------------------------------------------------------------
  */
 static int
@@ -1031,12 +2593,13 @@ TclX_KeylgetObjCmd (clientData, interp, objc, objv)
     Tcl_Obj	*CONST objv[];
 {
     Tcl_Obj *keylPtr, *valuePtr;
+    keylPath_t *pathPtr;
     char *key;
     int keyLen, status;
 
-    if ((objc < 2) || (objc > 4)) {
+    if ((objc < 2) || ((objc > 4) && ((objc % 2) != 0))) {
 	return TclX_WrongArgs (interp, objv [0],
-			       "listvar ?key? ?retvar | {}?");
+			       "listvar ?key? ?retvar | {}? ?key retvar ...?");
     }
 
     /*
@@ -1050,6 +2613,12 @@ TclX_KeylgetObjCmd (clientData, interp, objc, objv)
 	return TCL_ERROR;
     }
 
+    /*
+     * Handle retrieving values for several keys.
+     */
+    if (objc > 4)
+	return KeylgetVarsCmd (interp, keylPtr, objc, objv);
+
     /*
      * Handle retrieving a value for a specified key.
      */
@@ -1058,7 +2627,9 @@ TclX_KeylgetObjCmd (clientData, interp, objc, objv)
 	return TCL_ERROR;
     }
 
-    status = TclX_KeyedListGet (interp, keylPtr, key, &valuePtr);
+    pathPtr = GetKeyedListPath (objv [2]);
+    status = KeyedListGet (interp, keylPtr, pathPtr, &valuePtr);
+    ReleaseKeyedListPath (pathPtr);
     if (status == TCL_ERROR)
 	return TCL_ERROR;
 
@@ -1110,6 +2681,7 @@ TclX_KeylsetObjCmd (clientData, interp, objc, objv)
     Tcl_Obj	*CONST objv[];
 {
     Tcl_Obj *keylVarPtr, *newVarObj;
+    keylPath_t *pathPtr;
     char *key;
     int idx, keyLen, result = TCL_OK;
 
@@ -1118,10 +2690,21 @@ TclX_KeylsetObjCmd (clientData, interp, objc, objv)
 			       "listvar key value ?key value...?");
     }
 
+    /*
+     * Check all of the keys first, so a bad key doesn't leave the list
+     * partially updated.
+     */
+    for (idx = 2; idx < objc; idx += 2) {
+	key = Tcl_GetStringFromObj (objv [idx], &keyLen);
+	if (ValidateKey(interp, key, keyLen) == TCL_ERROR) {
+	    return TCL_ERROR;
+	}
+    }
+
     /*
      * Get the variable that we are going to update.  If the var doesn't exist,
      * create it.  If it is shared by more than being a variable, duplicated
-     * it.
+     * it, once for all of the keys.
      */
     keylVarPtr = Tcl_ObjGetVar2(interp, objv[1], NULL, 0);
     if (keylVarPtr == NULL) {
@@ -1134,12 +2717,22 @@ TclX_KeylsetObjCmd (clientData, interp, objc, objv)
 	newVarObj = NULL;
     }
 
-    for (idx = 2; idx < objc; idx += 2) {
-	key = Tcl_GetStringFromObj (objv [idx], &keyLen);
-	if ((ValidateKey(interp, key, keyLen) == TCL_ERROR)
-		|| (TclX_KeyedListSet (interp, keylVarPtr, key, objv [idx+1])
-			!= TCL_OK)) {
-	    result = TCL_ERROR;
+    /*
+     * Check that all of the keys can be set, so a key whose path goes
+     * through a value that isn't a keyed list doesn't leave the list
+     * partially updated.
+     */
+    if ((Tcl_ConvertToType (interp, keylVarPtr, &keyedListType) != TCL_OK) ||
+	(CheckKeyedListPairs (interp, keylVarPtr, objc - 2,
+			      (Tcl_Obj **) objv + 2) != TCL_OK)) {
+	result = TCL_ERROR;
+    }
+
+    for (idx = 2; (result == TCL_OK) && (idx < objc); idx += 2) {
+	pathPtr = GetKeyedListPath (objv [idx]);
+	result = KeyedListSet (interp, keylVarPtr, pathPtr, 0, objv [idx+1]);
+	ReleaseKeyedListPath (pathPtr);
+	if (result != TCL_OK) {
 	    break;
 	}
     }
@@ -1156,6 +2749,56 @@ TclX_KeylsetObjCmd (clientData, interp, objc, objv)
     return result;
 }
 
+/*-----------------------------------------------------------------------------
+ * Tcl_KeylsetpairsObjCmd --
+ *     Implements the TCL keylsetpairs command:
+ *	   keylsetpairs listvar keyvaluelist
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_KeylsetpairsObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *keylVarPtr, *newVarObj;
+    int result;
+
+    if (objc != 3) {
+	return TclX_WrongArgs (interp, objv [0], "listvar keyvaluelist");
+    }
+
+    /*
+     * Get the variable that we are going to update.  If the var doesn't exist,
+     * create it.  If it is shared by more than being a variable, duplicated
+     * it.
+     */
+    keylVarPtr = Tcl_ObjGetVar2(interp, objv[1], NULL, 0);
+    if (keylVarPtr == NULL) {
+	newVarObj = keylVarPtr = TclX_NewKeyedListObj();
+	Tcl_IncrRefCount(newVarObj);
+    } else if (Tcl_IsShared(keylVarPtr)) {
+	newVarObj = keylVarPtr = Tcl_DuplicateObj(keylVarPtr);
+	Tcl_IncrRefCount(newVarObj);
+    } else {
+	newVarObj = NULL;
+    }
+
+    result = TclX_KeyedListSetPairs (interp, keylVarPtr, objv [2]);
+
+    if ((result == TCL_OK) &&
+	    (Tcl_ObjSetVar2(interp, objv[1], NULL, keylVarPtr,
+		    TCL_LEAVE_ERR_MSG) == NULL)) {
+	result = TCL_ERROR;
+    }
+
+    if (newVarObj != NULL) {
+	Tcl_DecrRefCount(newVarObj);
+    }
+    return result;
+}
+
 /*-----------------------------------------------------------------------------
  * Tcl_KeyldelObjCmd --
  *     Implements the TCL keyldel command:
@@ -1170,6 +2813,7 @@ TclX_KeyldelObjCmd (clientData, interp, objc, objv)
     Tcl_Obj	*CONST objv[];
 {
     Tcl_Obj *keylVarPtr, *keylPtr;
+    keylPath_t *pathPtr;
     char *key;
     int idx, keyLen, status;
 
@@ -1204,7 +2848,9 @@ TclX_KeyldelObjCmd (clientData, interp, objc, objv)
 	    return TCL_ERROR;
 	}
 
-	status = TclX_KeyedListDelete (interp, keylPtr, key);
+	pathPtr = GetKeyedListPath (objv [idx]);
+	status = KeyedListDelete (interp, keylPtr, pathPtr, 0);
+	ReleaseKeyedListPath (pathPtr);
 	switch (status) {
 	  case TCL_BREAK:
 	    TclX_AppendObjResult (interp, "key not found: \"",
@@ -1232,6 +2878,7 @@ TclX_KeylkeysObjCmd (clientData, interp, objc, objv)
     Tcl_Obj	*CONST objv[];
 {
     Tcl_Obj *keylPtr, *listObjPtr;
+    keylPath_t *pathPtr;
     char *key;
     int keyLen, status;
 
@@ -1250,14 +2897,19 @@ TclX_KeylkeysObjCmd (clientData, interp, objc, objv)
      */
     if (objc < 3) {
 	key = NULL;
+	pathPtr = NULL;
     } else {
 	key = Tcl_GetStringFromObj (objv [2], &keyLen);
 	if (ValidateKey(interp, key, keyLen) == TCL_ERROR) {
 	    return TCL_ERROR;
 	}
+	pathPtr = GetKeyedListPath (objv [2]);
     }
 
-    status = TclX_KeyedListGetKeys (interp, keylPtr, key, &listObjPtr);
+    status = KeyedListGetKeys (interp, keylPtr, pathPtr, &listObjPtr);
+    if (pathPtr != NULL) {
+	ReleaseKeyedListPath (pathPtr);
+    }
     switch (status) {
       case TCL_BREAK:
 	TclX_AppendObjResult (interp, "key not found: \"", key, "\"",
@@ -1272,6 +2924,306 @@ TclX_KeylkeysObjCmd (clientData, interp, objc, objv)
     return TCL_OK;
 }
 
+/*-----------------------------------------------------------------------------
+ * Tcl_KeylserializeObjCmd --
+ *     Implements the TCL keylserialize command:
+ *	   keylserialize listvar
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_KeylserializeObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *keylPtr, *dataPtr;
+
+    if (objc != 2) {
+	return TclX_WrongArgs (interp, objv [0], "listvar");
+    }
+
+    keylPtr = Tcl_ObjGetVar2(interp, objv[1], NULL, TCL_LEAVE_ERR_MSG);
+    if (keylPtr == NULL) {
+	return TCL_ERROR;
+    }
+
+    if (TclX_KeyedListSerialize (interp, keylPtr, &dataPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult (interp, dataPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * Tcl_KeyldeserializeObjCmd --
+ *     Implements the TCL keyldeserialize command:
+ *	   keyldeserialize listvar data
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_KeyldeserializeObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *keylPtr;
+
+    if (objc != 3) {
+	return TclX_WrongArgs (interp, objv [0], "listvar data");
+    }
+
+    if (TclX_KeyedListDeserialize (interp, objv [2], &keylPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_IncrRefCount (keylPtr);
+    if (Tcl_ObjSetVar2(interp, objv[1], NULL, keylPtr,
+		       TCL_LEAVE_ERR_MSG) == NULL) {
+	Tcl_DecrRefCount (keylPtr);
+	return TCL_ERROR;
+    }
+    Tcl_DecrRefCount (keylPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * AddKeyedListStat --
+ *   Add an entry to the keyed list of statistics returned by keylstats.  The
+ * entry is appended without a lookup, so building the result doesn't change
+ * the lookup counts.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation of the result.
+ *   o key - Name of the statistic, which must not already be in the list.
+ *   o valuePtr - Value of the statistic.
+ *-----------------------------------------------------------------------------
+ */
+static void
+AddKeyedListStat (keylIntPtr, key, valuePtr)
+    keylIntObj_t *keylIntPtr;
+    char	 *key;
+    Tcl_Obj	 *valuePtr;
+{
+    keylKey_t *keyPtr;
+
+    keyPtr = InternKeyedListKey (key, strlen (key));
+    AddKeyedListEntry (keylIntPtr, keyPtr, valuePtr);
+    ReleaseKeyedListKey (keyPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * CollectKeyedListStats --
+ *   Add the totals for a keyed list and the keyed lists nested in it to a
+ * statistics structure.  Values that are not currently keyed list objects
+ * are not converted, so they are not counted as nested keyed lists.
+ *
+ * Parameters:
+ *   o keylIntPtr - Keyed list internal representation.
+ *   o statsPtr - Totals are added to this structure.
+ *-----------------------------------------------------------------------------
+ */
+static void
+CollectKeyedListStats (keylIntPtr, statsPtr)
+    keylIntObj_t *keylIntPtr;
+    keylStats_t  *statsPtr;
+{
+    keylEntry_t *entryPtr;
+    int idx;
+
+    statsPtr->memBytes += sizeof (keylIntObj_t) +
+	(keylIntPtr->arraySize * sizeof (keylEntry_t));
+#ifndef NO_KEYLIST_HASH_TABLE
+    if (keylIntPtr->hashTbl != NULL) {
+	statsPtr->memBytes += sizeof (Tcl_HashTable) +
+	    (keylIntPtr->hashTbl->numBuckets * sizeof (Tcl_HashEntry *)) +
+	    (keylIntPtr->hashTbl->numEntries * sizeof (Tcl_HashEntry));
+    }
+#endif
+
+    for (idx = 0; idx < keylIntPtr->numSlots; idx++) {
+	entryPtr = &(keylIntPtr->entries [idx]);
+	if (entryPtr->keyPtr == NULL)
+	    continue;
+	statsPtr->numEntries++;
+	statsPtr->keyBytes += entryPtr->keyPtr->keyLen;
+	if (entryPtr->valuePtr->typePtr == &keyedListType) {
+	    statsPtr->numChildren++;
+	    CollectKeyedListStats ((keylIntObj_t *)
+		    entryPtr->valuePtr->internalRep.otherValuePtr, statsPtr);
+	}
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Tcl_KeylstatsObjCmd --
+ *     Implements the TCL keylstats command:
+ *	   keylstats ?listvar?
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_KeylstatsObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+    Tcl_Obj *keylPtr, *statsPtr;
+    keylIntObj_t *keylIntPtr, *statsIntPtr;
+    keylStats_t stats;
+    int numBuckets = 0, usedBuckets = 0, maxChain = 0, hasIndex = FALSE;
+    unsigned long hashLookups, linearScans, scannedSlots;
+
+    if (objc > 2) {
+	return TclX_WrongArgs (interp, objv [0], "?listvar?");
+    }
+
+    hashLookups = tsdPtr->hashLookups;
+    linearScans = tsdPtr->linearScans;
+    scannedSlots = tsdPtr->scannedSlots;
+
+    statsPtr = TclX_NewSizedKeyedListObj (14);
+    Tcl_IncrRefCount (statsPtr);
+    statsIntPtr = (keylIntObj_t *) statsPtr->internalRep.otherValuePtr;
+
+    if (objc == 2) {
+	keylPtr = Tcl_ObjGetVar2(interp, objv[1], NULL, TCL_LEAVE_ERR_MSG);
+	if ((keylPtr == NULL) ||
+		(Tcl_ConvertToType (interp, keylPtr,
+				    &keyedListType) != TCL_OK)) {
+	    Tcl_DecrRefCount (statsPtr);
+	    return TCL_ERROR;
+	}
+	keylIntPtr = (keylIntObj_t *) keylPtr->internalRep.otherValuePtr;
+
+#ifndef NO_KEYLIST_HASH_TABLE
+	if (keylIntPtr->hashTbl != NULL) {
+	    Tcl_HashEntry *hashEntryPtr;
+	    int idx, chain;
+
+	    hasIndex = TRUE;
+	    numBuckets = keylIntPtr->hashTbl->numBuckets;
+	    for (idx = 0; idx < numBuckets; idx++) {
+		chain = 0;
+		for (hashEntryPtr = keylIntPtr->hashTbl->buckets [idx];
+			hashEntryPtr != NULL;
+			hashEntryPtr = hashEntryPtr->nextPtr) {
+		    chain++;
+		}
+		if (chain > 0)
+		    usedBuckets++;
+		if (chain > maxChain)
+		    maxChain = chain;
+	    }
+	}
+#endif
+	memset (&stats, 0, sizeof (stats));
+	CollectKeyedListStats (keylIntPtr, &stats);
+
+	AddKeyedListStat (statsIntPtr, "entries",
+			  Tcl_NewIntObj (keylIntPtr->numEntries));
+	AddKeyedListStat (statsIntPtr, "slots",
+			  Tcl_NewIntObj (keylIntPtr->numSlots));
+	AddKeyedListStat (statsIntPtr, "capacity",
+			  Tcl_NewIntObj (keylIntPtr->arraySize));
+	AddKeyedListStat (statsIntPtr, "hashindex",
+			  Tcl_NewBooleanObj (hasIndex));
+	AddKeyedListStat (statsIntPtr, "buckets",
+			  Tcl_NewIntObj (numBuckets));
+	AddKeyedListStat (statsIntPtr, "usedbuckets",
+			  Tcl_NewIntObj (usedBuckets));
+	AddKeyedListStat (statsIntPtr, "maxchain",
+			  Tcl_NewIntObj (maxChain));
+	AddKeyedListStat (statsIntPtr, "totalentries",
+			  Tcl_NewLongObj (stats.numEntries));
+	AddKeyedListStat (statsIntPtr, "children",
+			  Tcl_NewLongObj (stats.numChildren));
+	AddKeyedListStat (statsIntPtr, "keybytes",
+			  Tcl_NewLongObj (stats.keyBytes));
+	AddKeyedListStat (statsIntPtr, "memory",
+			  Tcl_NewLongObj (stats.memBytes));
+    }
+
+    AddKeyedListStat (statsIntPtr, "hashlookups",
+		      Tcl_NewLongObj ((long) hashLookups));
+    AddKeyedListStat (statsIntPtr, "linearscans",
+		      Tcl_NewLongObj ((long) linearScans));
+    AddKeyedListStat (statsIntPtr, "scannedslots",
+		      Tcl_NewLongObj ((long) scannedSlots));
+
+    Tcl_InvalidateStringRep (statsPtr);
+    Tcl_SetObjResult (interp, statsPtr);
+    Tcl_DecrRefCount (statsPtr);
+    return TCL_OK;
+}
+
+#if (TCL_MAJOR_VERSION > 8) || (TCL_MINOR_VERSION >= 5)
+/*-----------------------------------------------------------------------------
+ * Tcl_Keyl2dictObjCmd --
+ *     Implements the TCL keyl2dict command:
+ *	   keyl2dict listvar
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_Keyl2dictObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *keylPtr, *dictPtr;
+
+    if (objc != 2) {
+	return TclX_WrongArgs (interp, objv [0], "listvar");
+    }
+
+    keylPtr = Tcl_ObjGetVar2(interp, objv[1], NULL, TCL_LEAVE_ERR_MSG);
+    if (keylPtr == NULL) {
+	return TCL_ERROR;
+    }
+
+    if (TclX_KeyedListToDict (interp, keylPtr, &dictPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult (interp, dictPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * Tcl_Dict2keylObjCmd --
+ *     Implements the TCL dict2keyl command:
+ *	   dict2keyl listvar dict
+ *-----------------------------------------------------------------------------
+ */
+static int
+TclX_Dict2keylObjCmd (clientData, interp, objc, objv)
+    ClientData	 clientData;
+    Tcl_Interp	*interp;
+    int		 objc;
+    Tcl_Obj	*CONST objv[];
+{
+    Tcl_Obj *keylPtr;
+
+    if (objc != 3) {
+	return TclX_WrongArgs (interp, objv [0], "listvar dict");
+    }
+
+    if (TclX_DictToKeyedList (interp, objv [2], &keylPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_IncrRefCount (keylPtr);
+    if (Tcl_ObjSetVar2(interp, objv[1], NULL, keylPtr,
+		       TCL_LEAVE_ERR_MSG) == NULL) {
+	Tcl_DecrRefCount (keylPtr);
+	return TCL_ERROR;
+    }
+    Tcl_DecrRefCount (keylPtr);
+    return TCL_OK;
+}
+#endif
+
 /*-----------------------------------------------------------------------------
  * TclX_KeyedListInit --
  *   Initialize the keyed list commands for this interpreter.
@@ -1292,11 +3244,32 @@ TclX_KeyedListInit (interp)
     Tcl_CreateObjCommand (interp, "keylset", TclX_KeylsetObjCmd,
 	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
 
+    Tcl_CreateObjCommand (interp, "keylsetpairs", TclX_KeylsetpairsObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
     Tcl_CreateObjCommand (interp, "keyldel", TclX_KeyldelObjCmd,
 	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
 
     Tcl_CreateObjCommand (interp, "keylkeys", TclX_KeylkeysObjCmd,
 	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
+    Tcl_CreateObjCommand (interp, "keylserialize", TclX_KeylserializeObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
+    Tcl_CreateObjCommand (interp, "keyldeserialize",
+	    TclX_KeyldeserializeObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
+    Tcl_CreateObjCommand (interp, "keylstats", TclX_KeylstatsObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
+#if (TCL_MAJOR_VERSION > 8) || (TCL_MINOR_VERSION >= 5)
+    Tcl_CreateObjCommand (interp, "keyl2dict", TclX_Keyl2dictObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+
+    Tcl_CreateObjCommand (interp, "dict2keyl", TclX_Dict2keylObjCmd,
+	    (ClientData) NULL, (Tcl_CmdDeleteProc*) NULL);
+#endif
 }
 
 
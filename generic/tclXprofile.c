@@ -23,6 +23,45 @@
  */
 #define UNKNOWN_LEVEL -1
 
+/*
+ * Log-linear histogram of call durations in nanoseconds, kept with -latency.
+ * Durations below PROF_HIST_LINEAR have a bucket each, above that each power
+ * of two is split into PROF_HIST_SUB buckets, giving a relative error of
+ * about 6%.  Durations with a highest bit above PROF_HIST_MAX_EXP, 78 hours
+ * or more, are counted in the last bucket.
+ */
+#define PROF_HIST_SUB_BITS  4
+#define PROF_HIST_SUB       (1 << PROF_HIST_SUB_BITS)
+#define PROF_HIST_LINEAR    (2 * PROF_HIST_SUB)
+#define PROF_HIST_MAX_EXP   47
+#define PROF_HIST_SIZE \
+    (PROF_HIST_LINEAR + (PROF_HIST_MAX_EXP - PROF_HIST_SUB_BITS) * PROF_HIST_SUB)
+
+/*
+ * Node of the calling context tree that the profile data is collected in.
+ * There is a node for each distinct call stack, which is a child of the node
+ * of its caller in either the variable scope or eval stack, based on the
+ * -eval option.  Children are identified by their command, or by name for
+ * the global context and the procedures that were already running when
+ * profiling was turned on.  A node's counters are updated when a stack entry
+ * using it is popped, the stack list used to return the data is only built
+ * when profiling is turned off.
+ */
+typedef struct profNode_t {
+    Tcl_Command         cmd;              /* Command, or NULL.             */
+    char               *cmdName;          /* Command name.                 */
+    Tcl_WideInt         count;            /* Number of calls.              */
+    Tcl_WideInt         realTime;         /* Cumulative real and CPU time, */
+    Tcl_WideInt         cpuTime;          /* in nanoseconds.               */
+    struct profNode_t  *parentPtr;        /* Node of the caller.           */
+    struct profNode_t  *childPtr;         /* First node called from here.  */
+    struct profNode_t  *siblingPtr;       /* Next child of the parent.     */
+    unsigned int       *histogram;        /* Call durations, or NULL.      */
+    Tcl_WideInt         maxTime;          /* Longest call duration.        */
+    Tcl_WideInt         allocBytes;       /* Cumulative heap growth and    */
+    Tcl_WideInt         freeBytes;        /* shrinkage, in bytes.          */
+} profNode_t;
+
 /*
  * Stack entry used to keep track of an profiling information for procedures
  * (and commands in command mode).  This stack mirrors the Tcl procedure stack.
@@ -39,22 +78,32 @@ typedef struct profEntry_t {
     int                 procLevel;        /* Procedure level.              */ 
     int                 scopeLevel;       /* Varaible scope level.         */ 
     int                 evalLevel;        /* Tcl_Eval level.               */ 
-    clock_t             evalRealTime;     /* Cumulative real and CPU time  */
-    clock_t             evalCpuTime;      /* entry was on top of stack.    */
-    clock_t             scopeRealTime;    /* Cumulative Real and CPU time  */
-    clock_t             scopeCpuTime;     /* entry's scope was active.     */
+    Tcl_WideInt         evalRealTime;     /* Cumulative real and CPU time  */
+    Tcl_WideInt         evalCpuTime;      /* entry was on top of stack.    */
+    Tcl_WideInt         scopeRealTime;    /* Cumulative Real and CPU time  */
+    Tcl_WideInt         scopeCpuTime;     /* entry's scope was active.     */
+    Tcl_WideInt         evalAllocBytes;   /* Heap growth and shrinkage     */
+    Tcl_WideInt         evalFreeBytes;    /* while on top of stack.        */
+    Tcl_WideInt         scopeAllocBytes;  /* Heap growth and shrinkage     */
+    Tcl_WideInt         scopeFreeBytes;   /* while entry's scope active.   */
+    Tcl_WideInt         startRealTime;    /* Real time when pushed.        */
+    profNode_t         *nodePtr;          /* Calling context tree node.    */
     struct profEntry_t *prevEntryPtr;     /* Procedure call stack.         */
     struct profEntry_t *prevScopePtr;     /* Procedure var scope chain.    */
-    char                cmdName [1];      /* Command name. MUST BE LAST!   */
 } profEntry_t;
 
 /*
- * Data keeped on a stack snapshot.
+ * Data keeped on a stack snapshot when the calling context tree is returned.
+ * Times are in nanoseconds.
  */
 typedef struct profDataEntry_t {
-    clock_t count;
-    clock_t realTime;
-    clock_t cpuTime;
+    Tcl_WideInt   count;
+    Tcl_WideInt   realTime;
+    Tcl_WideInt   cpuTime;
+    unsigned int *histogram;
+    Tcl_WideInt   maxTime;
+    Tcl_WideInt   allocBytes;
+    Tcl_WideInt   freeBytes;
 } profDataEntry_t;
 
 /*
@@ -67,31 +116,144 @@ typedef struct profInfo_t {
     Tcl_Trace       traceHandle;           /* Handle to current trace.       */
     int             commandMode;           /* Prof all commands?             */
     int             evalMode;              /* Use eval stack.                */
+    int             latencyMode;           /* Keep duration histograms.      */
+    int             memoryMode;            /* Track heap size.               */
+    long            sampleUsec;            /* Sample interval, 0 if tracing. */
+    Tcl_AsyncHandler sampleHandler;        /* Records a sample.              */
     Tcl_Command     currentCmd;            /* Current command table entry.   */
     Tcl_CmdInfo     savedCmdInfo;          /* Details about the current cmd. */
     int             evalLevel;             /* Eval level when invoked.       */
-    clock_t         realTime;              /* Current real and CPU time.     */
-    clock_t         cpuTime;
-    clock_t         prevRealTime;          /* Real and CPU time of previous  */
-    clock_t         prevCpuTime;           /* trace.                         */
+    Tcl_WideInt     realTime;              /* Current real and CPU time, in  */
+    Tcl_WideInt     cpuTime;               /* nanoseconds.                   */
+    Tcl_WideInt     prevRealTime;          /* Real and CPU time of previous  */
+    Tcl_WideInt     prevCpuTime;           /* trace.                         */
     int             updatedTimes;          /* Has current times been updated?*/
+    Tcl_WideInt     heapSize;              /* Last heap size read and heap   */
+    Tcl_WideInt     prevHeapSize;          /* size charged, with -memory.    */
+    int             allocatedHeap;         /* Profiler allocated memory.     */
     profEntry_t    *stackPtr;              /* Proc/command nesting stack.    */
     int             stackSize;             /* Size of the stack.             */
     profEntry_t    *scopeChainPtr;         /* Variable scope chain.          */
+    profEntry_t    *freeEntryPtr;          /* Entries free for reuse.        */
+    profNode_t      rootNode;              /* Root of calling context tree.  */
+    Tcl_TimerToken  dumpTimer;             /* Auto-dump timer, or NULL.      */
+    int             dumpInterval;          /* Auto-dump interval in ms.      */
+    int             dumpReset;             /* Reset data after auto-dumps.   */
+    char           *dumpFile;              /* File auto-dumps are appended to*/
     Tcl_HashTable   profDataTable;         /* Cumulative time table, Keyed   */
                                            /* by call stack list.            */
 } profInfo_t;
 
+/*
+ * State used while encoding the calling context tree as a pprof profile.
+ * The string table, functions and samples are encoded as they are found,
+ * one location is made for each function, with the same id.
+ */
+typedef struct pprofInfo_t {
+    Tcl_HashTable   stringTable;           /* String to string table index.  */
+    int             numStrings;
+    Tcl_HashTable   functionTable;         /* Name to function id.           */
+    int             numFunctions;
+    Tcl_DString     strings;               /* Encoded string_table entries.  */
+    Tcl_DString     functions;             /* Encoded function and location  */
+                                           /* entries.                       */
+    Tcl_DString     samples;               /* Encoded sample entries.        */
+    Tcl_WideUInt   *stack;                 /* Function ids of current path.  */
+    int             stackSize;
+    int             memoryMode;            /* Include heap values.           */
+} pprofInfo_t;
+
+/*
+ * Field numbers of the pprof protocol buffer messages (profile.proto) that
+ * are written.
+ */
+#define PPROF_PROFILE_SAMPLE_TYPE         1
+#define PPROF_PROFILE_SAMPLE              2
+#define PPROF_PROFILE_LOCATION            4
+#define PPROF_PROFILE_FUNCTION            5
+#define PPROF_PROFILE_STRING_TABLE        6
+#define PPROF_PROFILE_PERIOD_TYPE        11
+#define PPROF_PROFILE_PERIOD             12
+#define PPROF_PROFILE_DEFAULT_SAMPLE_TYPE 14
+#define PPROF_VALUE_TYPE_TYPE             1
+#define PPROF_VALUE_TYPE_UNIT             2
+#define PPROF_SAMPLE_LOCATION_ID          1
+#define PPROF_SAMPLE_VALUE                2
+#define PPROF_LOCATION_ID                 1
+#define PPROF_LOCATION_LINE               4
+#define PPROF_LINE_FUNCTION_ID            1
+#define PPROF_FUNCTION_ID                 1
+#define PPROF_FUNCTION_NAME               2
+#define PPROF_FUNCTION_SYSTEM_NAME        3
+
+/*
+ * Number of values in the data of a stack.  The latency values follow the
+ * count, real and CPU time, the heap values are last.  The heap values are
+ * recognized in data that is read back by the length of the list.
+ */
+#define PROF_DATA_BASIC    3
+#define PROF_DATA_LATENCY  4
+#define PROF_DATA_MEMORY   2
+#define PROF_DATA_MAX      (PROF_DATA_BASIC + PROF_DATA_LATENCY + \
+                            PROF_DATA_MEMORY)
+
+/*
+ * Element of the array sorted by profile sort.
+ */
+typedef struct profSortEntry_t {
+    Tcl_Obj    *stackObj;
+    Tcl_WideInt value;
+} profSortEntry_t;
+
 /*
  * Argument to panic on logic errors.  Takes an id number.
  */
 static const char *PROF_PANIC = "TclX profile bug id = %d\n";
 
+/*
+ * The profiling timer is process wide, so only one interpreter can be
+ * sampling at a time.  This is the async handler of that interpreter, which
+ * is marked on each tick of the timer.  A tick may have read it just before
+ * sampling is turned off, so the handler is not deleted until the profile
+ * command is deleted; RecordSample ignores ticks while sampling is off.
+ */
+static Tcl_AsyncHandler sampleAsyncHandler = NULL;
+TCL_DECLARE_MUTEX(sampleMutex)
+
 /*
  * Prototypes of internal functions.
  */
+static profNode_t *
+FindProfNode _ANSI_ARGS_((profInfo_t  *infoPtr,
+                          profNode_t  *parentPtr,
+                          Tcl_Command  cmd,
+                          const char  *cmdName));
+
+static void
+FreeProfNodes _ANSI_ARGS_((profNode_t *nodePtr));
+
+static int
+HistogramIndex _ANSI_ARGS_((Tcl_WideInt value));
+
+static Tcl_WideInt
+HistogramValue _ANSI_ARGS_((int idx));
+
+static void
+RecordLatency _ANSI_ARGS_((profNode_t  *nodePtr,
+                           Tcl_WideInt  duration));
+
+static Tcl_Obj *
+HistogramPercentile _ANSI_ARGS_((unsigned int *histogram,
+                                 Tcl_WideInt   maxTime,
+                                 int           percent));
+
+static void
+ExportProfNodes _ANSI_ARGS_((profInfo_t *infoPtr,
+                             profNode_t *nodePtr));
+
 static void
 PushEntry _ANSI_ARGS_((profInfo_t *infoPtr,
+                       Tcl_Command cmd,
                        const char *cmdName,
                        int         isProc,
                        int         procLevel,
@@ -99,14 +261,15 @@ PushEntry _ANSI_ARGS_((profInfo_t *infoPtr,
                        int         evalLevel));
 
 static void
-RecordData _ANSI_ARGS_((profInfo_t  *infoPtr,
-                        profEntry_t *entryPtr));
+RecordData _ANSI_ARGS_((profInfo_t *infoPtr,
+                        profNode_t *nodePtr));
 
 static void
 PopEntry _ANSI_ARGS_((profInfo_t *infoPtr));
 
 static void
-UpdateTOSTimes _ANSI_ARGS_((profInfo_t *infoPtr));
+UpdateTOSTimes _ANSI_ARGS_((profInfo_t *infoPtr,
+                            int         sampleHeap));
 
 static void
 ProfCommandEvalSetup _ANSI_ARGS_((profInfo_t *infoPtr,
@@ -133,6 +296,9 @@ static Tcl_CmdObjTraceProc ProfTraceRoutine;
 static void
 CleanDataTable _ANSI_ARGS_((profInfo_t *infoPtr));
 
+static void
+CleanProfData _ANSI_ARGS_((profInfo_t *infoPtr));
+
 static void
 InitializeProcStack _ANSI_ARGS_((profInfo_t *infoPtr,
                                  CallFrame  *framePtr));
@@ -140,15 +306,141 @@ InitializeProcStack _ANSI_ARGS_((profInfo_t *infoPtr,
 static void
 TurnOnProfiling _ANSI_ARGS_((profInfo_t *infoPtr,
                              int         commandMode,
-                             int         evalMode));
+                             int         evalMode,
+                             int         latencyMode,
+                             int         memoryMode));
+
+static void
+SampleTick _ANSI_ARGS_((void));
+
+static profNode_t *
+SampleFrameNode _ANSI_ARGS_((profInfo_t *infoPtr,
+                             CallFrame  *framePtr));
+
+static int
+RecordSample _ANSI_ARGS_((ClientData  clientData,
+                          Tcl_Interp *interp,
+                          int         code));
+
+static int
+TurnOnSampling _ANSI_ARGS_((Tcl_Interp *interp,
+                            profInfo_t *infoPtr,
+                            long        sampleUsec,
+                            int         evalMode));
+
+static void
+TurnOffSampling _ANSI_ARGS_((profInfo_t *infoPtr));
 
 static void
 DeleteProfTrace _ANSI_ARGS_((profInfo_t *infoPtr));
 
+static void
+AppendVarint _ANSI_ARGS_((Tcl_DString  *bufPtr,
+                          Tcl_WideUInt  value));
+
+static void
+AppendVarintField _ANSI_ARGS_((Tcl_DString  *bufPtr,
+                               int           field,
+                               Tcl_WideUInt  value));
+
+static void
+AppendBytesField _ANSI_ARGS_((Tcl_DString *bufPtr,
+                              int          field,
+                              const char  *bytes,
+                              int          length));
+
+static int
+WriteFolded _ANSI_ARGS_((Tcl_Channel  channel,
+                         profNode_t  *nodePtr,
+                         Tcl_DString *pathPtr));
+
+static int
+PprofString _ANSI_ARGS_((pprofInfo_t *pprofPtr,
+                         const char  *str));
+
+static int
+PprofFunction _ANSI_ARGS_((pprofInfo_t *pprofPtr,
+                           const char  *name));
+
+static void
+PprofSamples _ANSI_ARGS_((pprofInfo_t *pprofPtr,
+                          profNode_t  *nodePtr,
+                          int          depth));
+
+static int
+WritePprof _ANSI_ARGS_((Tcl_Channel  channel,
+                        profInfo_t  *infoPtr,
+                        long         sampleUsec));
+
+static int
+DumpDataTable _ANSI_ARGS_((Tcl_Interp *interp,
+                           profInfo_t *infoPtr,
+                           char       *varName,
+                           Tcl_Obj    *listPtr));
+
+static void
+FlushEntryTimes _ANSI_ARGS_((profInfo_t *infoPtr));
+
+static void
+ResetProfNodes _ANSI_ARGS_((profNode_t *nodePtr));
+
+static int
+TakeSnapshot _ANSI_ARGS_((Tcl_Interp *interp,
+                          profInfo_t *infoPtr,
+                          int         reset,
+                          char       *varName,
+                          Tcl_Obj    *listPtr));
+
+static void
+AutoDumpProc _ANSI_ARGS_((ClientData clientData));
+
+static void
+StopAutoDump _ANSI_ARGS_((profInfo_t *infoPtr));
+
+static int
+ProfileSnapshotCmd _ANSI_ARGS_((Tcl_Interp *interp,
+                                profInfo_t *infoPtr,
+                                int         objc,
+                                Tcl_Obj   *CONST objv[]));
+
+static int
+ProfileAutoDumpCmd _ANSI_ARGS_((Tcl_Interp *interp,
+                                profInfo_t *infoPtr,
+                                int         objc,
+                                Tcl_Obj   *CONST objv[]));
+
+static Tcl_Obj *
+GetProfArray _ANSI_ARGS_((Tcl_Interp *interp,
+                          Tcl_Obj    *varNameObj,
+                          int        *elemcPtr,
+                          Tcl_Obj  ***elemvPtr));
+
+static int
+GetProfArrayData _ANSI_ARGS_((Tcl_Interp  *interp,
+                              Tcl_Obj     *dataObj,
+                              Tcl_WideInt *dataPtr,
+                              int         *hasMemoryPtr));
+
+static int
+ProfileSumCmd _ANSI_ARGS_((Tcl_Interp *interp,
+                           int         objc,
+                           Tcl_Obj   *CONST objv[]));
+
 static int
-TurnOffProfiling _ANSI_ARGS_((Tcl_Interp *interp,
-                              profInfo_t *infoPtr,
-                              char       *varName));
+ProfSortCompare _ANSI_ARGS_((CONST VOID *left,
+                             CONST VOID *right));
+
+static int
+ProfileSortCmd _ANSI_ARGS_((Tcl_Interp *interp,
+                            int         objc,
+                            Tcl_Obj   *CONST objv[]));
+
+static int
+TurnOffProfiling _ANSI_ARGS_((Tcl_Interp  *interp,
+                              profInfo_t  *infoPtr,
+                              char        *varName,
+                              Tcl_Channel  foldedChan,
+                              Tcl_Channel  pprofChan));
 
 static int
 TclX_ProfileObjCmd _ANSI_ARGS_((ClientData   clientData,
@@ -160,6 +452,236 @@ static void
 ProfMonCleanUp _ANSI_ARGS_((ClientData  clientData,
                             Tcl_Interp *interp));
 
+
+/*-----------------------------------------------------------------------------
+ * FindProfNode --
+ *   Find the calling context tree node for a command called from the context
+ * of another node, adding it if this is the first call.  A found node is
+ * moved to the front of its parent's children, as a procedure tends to call
+ * the same commands repeatedly.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *   o parentPtr - The node of the calling context.
+ *   o cmd - The command, or NULL if it is identified by name.
+ *   o cmdName - The name of the command, only used if cmd is NULL.  The name
+ *     of a command is gotten when its node is added.
+ * Returns:
+ *   A pointer to the node.
+ *-----------------------------------------------------------------------------
+ */
+static profNode_t *
+FindProfNode (infoPtr, parentPtr, cmd, cmdName)
+    profInfo_t  *infoPtr;
+    profNode_t  *parentPtr;
+    Tcl_Command  cmd;
+    const char  *cmdName;
+{
+    profNode_t *nodePtr, *prevPtr = NULL;
+    Tcl_Obj *fullCmdNamePtr;
+
+    for (nodePtr = parentPtr->childPtr; nodePtr != NULL;
+         prevPtr = nodePtr, nodePtr = nodePtr->siblingPtr) {
+        if ((nodePtr->cmd == cmd) &&
+            ((cmd != NULL) || STREQU (nodePtr->cmdName, cmdName))) {
+            if (prevPtr != NULL) {
+                prevPtr->siblingPtr = nodePtr->siblingPtr;
+                nodePtr->siblingPtr = parentPtr->childPtr;
+                parentPtr->childPtr = nodePtr;
+            }
+            return nodePtr;
+        }
+    }
+
+    /*
+     * Add a new node.  The command is preserved so that its structure is not
+     * reused for another command while the node refers to it.
+     */
+    nodePtr = (profNode_t *) ckalloc (sizeof (profNode_t));
+    nodePtr->cmd = cmd;
+    if (cmd != NULL) {
+        ((Command *) cmd)->refCount++;
+        fullCmdNamePtr = Tcl_NewObj ();
+        Tcl_GetCommandFullName (infoPtr->interp, cmd, fullCmdNamePtr);
+        cmdName = Tcl_GetStringFromObj (fullCmdNamePtr, NULL);
+        nodePtr->cmdName = ckstrdup (cmdName);
+        Tcl_DecrRefCount (fullCmdNamePtr);
+    } else {
+        nodePtr->cmdName = ckstrdup (cmdName);
+    }
+    nodePtr->count = 0;
+    nodePtr->realTime = 0;
+    nodePtr->cpuTime = 0;
+    nodePtr->parentPtr = parentPtr;
+    nodePtr->childPtr = NULL;
+    nodePtr->siblingPtr = parentPtr->childPtr;
+    nodePtr->histogram = NULL;
+    nodePtr->maxTime = 0;
+    nodePtr->allocBytes = 0;
+    nodePtr->freeBytes = 0;
+    parentPtr->childPtr = nodePtr;
+    infoPtr->allocatedHeap = TRUE;
+    return nodePtr;
+}
+
+/*-----------------------------------------------------------------------------
+ * FreeProfNodes --
+ *   Free the children of a calling context tree node and all of their
+ * descendants.
+ *
+ * Parameters:
+ *   o nodePtr - The node whose children are freed.
+ *-----------------------------------------------------------------------------
+ */
+static void
+FreeProfNodes (nodePtr)
+    profNode_t *nodePtr;
+{
+    profNode_t *childPtr;
+
+    while (nodePtr->childPtr != NULL) {
+        childPtr = nodePtr->childPtr;
+        nodePtr->childPtr = childPtr->siblingPtr;
+        FreeProfNodes (childPtr);
+        if (childPtr->cmd != NULL)
+            TclCleanupCommand ((Command *) childPtr->cmd);
+        if (childPtr->histogram != NULL)
+            ckfree ((char *) childPtr->histogram);
+        ckfree (childPtr->cmdName);
+        ckfree ((char *) childPtr);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * HistogramIndex --
+ *   Get the index of the duration histogram bucket that a value falls in.
+ *
+ * Parameters:
+ *   o value - The duration, in nanoseconds.
+ * Returns:
+ *   The bucket index.
+ *-----------------------------------------------------------------------------
+ */
+static int
+HistogramIndex (value)
+    Tcl_WideInt value;
+{
+    Tcl_WideInt scan;
+    int exp;
+
+    if (value < PROF_HIST_LINEAR)
+        return (value < 0) ? 0 : (int) value;
+
+    /*
+     * Find the highest bit set, the next PROF_HIST_SUB_BITS bits select the
+     * bucket within the power of two.
+     */
+    exp = 0;
+    for (scan = value; scan >= 256; scan >>= 8)
+        exp += 8;
+    for (; scan > 1; scan >>= 1)
+        exp++;
+    if (exp > PROF_HIST_MAX_EXP)
+        return PROF_HIST_SIZE - 1;
+
+    return PROF_HIST_LINEAR +
+        (exp - PROF_HIST_SUB_BITS - 1) * PROF_HIST_SUB +
+        (int) ((value >> (exp - PROF_HIST_SUB_BITS)) & (PROF_HIST_SUB - 1));
+}
+
+/*-----------------------------------------------------------------------------
+ * HistogramValue --
+ *   Get the highest value that falls in a duration histogram bucket.
+ *
+ * Parameters:
+ *   o idx - The bucket index.
+ * Returns:
+ *   The value, in nanoseconds.
+ *-----------------------------------------------------------------------------
+ */
+static Tcl_WideInt
+HistogramValue (idx)
+    int idx;
+{
+    int exp, sub;
+
+    if (idx < PROF_HIST_LINEAR)
+        return idx;
+    exp = (idx - PROF_HIST_LINEAR) / PROF_HIST_SUB + PROF_HIST_SUB_BITS + 1;
+    sub = (idx - PROF_HIST_LINEAR) % PROF_HIST_SUB;
+    return (((Tcl_WideInt) (PROF_HIST_SUB + sub + 1)) <<
+            (exp - PROF_HIST_SUB_BITS)) - 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * RecordLatency --
+ *   Add the duration of a call to the histogram of its calling context tree
+ * node, allocating the histogram on the first call.
+ *
+ * Parameters:
+ *   o nodePtr - The node of the call.
+ *   o duration - The real time the call took, in nanoseconds.
+ *-----------------------------------------------------------------------------
+ */
+static void
+RecordLatency (nodePtr, duration)
+    profNode_t  *nodePtr;
+    Tcl_WideInt  duration;
+{
+    if (nodePtr->histogram == NULL) {
+        nodePtr->histogram = (unsigned int *)
+            ckalloc (PROF_HIST_SIZE * sizeof (unsigned int));
+        memset (nodePtr->histogram, 0, PROF_HIST_SIZE * sizeof (unsigned int));
+    }
+    nodePtr->histogram [HistogramIndex (duration)]++;
+    if (duration > nodePtr->maxTime)
+        nodePtr->maxTime = duration;
+}
+
+/*-----------------------------------------------------------------------------
+ * HistogramPercentile --
+ *   Get a percentile of the durations in a histogram.  The highest value of
+ * the bucket the percentile falls in is returned, limited to the longest
+ * duration.
+ *
+ * Parameters:
+ *   o histogram - The histogram, or NULL if there were no calls.
+ *   o maxTime - The longest duration in the histogram.
+ *   o percent - The percentile, 100 returns the longest duration.
+ * Returns:
+ *   A new object containing the duration in nanoseconds.
+ *-----------------------------------------------------------------------------
+ */
+static Tcl_Obj *
+HistogramPercentile (histogram, maxTime, percent)
+    unsigned int *histogram;
+    Tcl_WideInt   maxTime;
+    int           percent;
+{
+    Tcl_WideInt total, target, value;
+    int idx;
+
+    if ((histogram == NULL) || (percent >= 100))
+        return Tcl_NewWideIntObj (maxTime);
+
+    total = 0;
+    for (idx = 0; idx < PROF_HIST_SIZE; idx++)
+        total += histogram [idx];
+
+    /*
+     * The target is the rank of the percentile, rounded up.
+     */
+    target = (total * percent + 99) / 100;
+    if (target < 1)
+        target = 1;
+    for (idx = 0; idx < PROF_HIST_SIZE - 1; idx++) {
+        target -= histogram [idx];
+        if (target <= 0)
+            break;
+    }
+    value = HistogramValue (idx);
+    return Tcl_NewWideIntObj ((value < maxTime) ? value : maxTime);
+}
 
 /*-----------------------------------------------------------------------------
  * PushEntry --
@@ -167,7 +689,8 @@ ProfMonCleanUp _ANSI_ARGS_((ClientData  clientData,
  *
  * Parameters:
  *   o infoPtr - The global profiling info.
- *   o cmdName  The procedure or command name.
+ *   o cmd - The procedure or command, NULL if it is only known by name.
+ *   o cmdName - The procedure or command name, if cmd is NULL.
  *   o isProc - TRUE if its a proc, FALSE if other command.
  *   o procLevel - The procedure call level that the procedure or command will
  *     execute at.
@@ -180,21 +703,27 @@ ProfMonCleanUp _ANSI_ARGS_((ClientData  clientData,
  *-----------------------------------------------------------------------------
  */
 static void
-PushEntry (infoPtr, cmdName, isProc, procLevel, scopeLevel, evalLevel)
+PushEntry (infoPtr, cmd, cmdName, isProc, procLevel, scopeLevel, evalLevel)
     profInfo_t *infoPtr;
+    Tcl_Command cmd;
     const char *cmdName;
     int         isProc;
     int         procLevel;
     int         scopeLevel;
     int         evalLevel;
 {
-    profEntry_t *entryPtr, *scanPtr;
+    profEntry_t *entryPtr, *scanPtr, *callerPtr;
 
     /*
-     * Calculate the size of an entry.  One byte for name is in the entry.
+     * Reuse a previously popped entry if there is one.
      */
-    entryPtr = (profEntry_t *) ckalloc (sizeof (profEntry_t) +
-                                        strlen (cmdName));
+    if (infoPtr->freeEntryPtr != NULL) {
+        entryPtr = infoPtr->freeEntryPtr;
+        infoPtr->freeEntryPtr = entryPtr->prevEntryPtr;
+    } else {
+        entryPtr = (profEntry_t *) ckalloc (sizeof (profEntry_t));
+        infoPtr->allocatedHeap = TRUE;
+    }
     
     /*
      * Fill it in and push onto the stack.  Note that the procedures frame has
@@ -209,7 +738,11 @@ PushEntry (infoPtr, cmdName, isProc, procLevel, scopeLevel, evalLevel)
     entryPtr->evalCpuTime = 0;
     entryPtr->scopeRealTime = 0;
     entryPtr->scopeCpuTime = 0;
-    strcpy (entryPtr->cmdName, cmdName);
+    entryPtr->evalAllocBytes = 0;
+    entryPtr->evalFreeBytes = 0;
+    entryPtr->scopeAllocBytes = 0;
+    entryPtr->scopeFreeBytes = 0;
+    entryPtr->startRealTime = infoPtr->realTime;
 
     /*
      * Push onto the stack and set the variable scope chain.  The variable
@@ -233,52 +766,61 @@ PushEntry (infoPtr, cmdName, isProc, procLevel, scopeLevel, evalLevel)
     }
     entryPtr->prevScopePtr = scanPtr;
     infoPtr->scopeChainPtr = entryPtr;
+
+    /*
+     * The calling context is either the eval or scope stack entry below us.
+     */
+    callerPtr = infoPtr->evalMode ? entryPtr->prevEntryPtr :
+        entryPtr->prevScopePtr;
+    entryPtr->nodePtr = FindProfNode (infoPtr,
+                                      (callerPtr == NULL) ? &infoPtr->rootNode :
+                                      callerPtr->nodePtr,
+                                      cmd, cmdName);
 }
 
 /*-----------------------------------------------------------------------------
  * RecordData --
- *   Record an entries times in the data table.
+ *   Record the counters of a calling context tree node in the data table,
+ * keyed by the stack list of the node.
  *
  * Parameters:
  *   o infoPtr - The global profiling info.
- *   o entryPtr - The entry to record.
+ *   o nodePtr - The node to record.
  *-----------------------------------------------------------------------------
  */
 static void
-RecordData (infoPtr, entryPtr)
-    profInfo_t  *infoPtr;
-    profEntry_t *entryPtr;
+RecordData (infoPtr, nodePtr)
+    profInfo_t *infoPtr;
+    profNode_t *nodePtr;
 {
-    int idx, newEntry;
-    profEntry_t *scanPtr;
+    int idx, depth, newEntry;
+    profNode_t *scanPtr;
     char **stackArgv, *stackListPtr;
     Tcl_HashEntry *hashEntryPtr;
     profDataEntry_t *dataEntryPtr;
 
     /*
-     * Build up a stack list.  Entry [0] is the top of the stack, either the
-     * scope or eval stack is followed, based on the -eval option.  If both
-     * scope and command mode are enabled, commands other than the top command
-     * are skipped.
+     * Build up a stack list.  Entry [0] is the top of the stack, the path
+     * back to the root of the tree follows either the scope or eval stack,
+     * based on the -eval option.
      */
-    stackArgv = (char **) ckalloc (sizeof (char *) * infoPtr->stackSize);
-    if (infoPtr->evalMode) {
-        for (idx= 0, scanPtr = entryPtr; scanPtr != NULL;
-             scanPtr = scanPtr->prevEntryPtr) {
-            stackArgv [idx++] = scanPtr->cmdName;
-        }
-    } else {
-        for (idx= 0, scanPtr = entryPtr; scanPtr != NULL;
-             scanPtr = scanPtr->prevScopePtr) {
-            stackArgv [idx++] = scanPtr->cmdName;
-        }
+    depth = 0;
+    for (scanPtr = nodePtr; scanPtr != &infoPtr->rootNode;
+         scanPtr = scanPtr->parentPtr) {
+        depth++;
+    }
+    stackArgv = (char **) ckalloc (sizeof (char *) * depth);
+    for (idx = 0, scanPtr = nodePtr; scanPtr != &infoPtr->rootNode;
+         scanPtr = scanPtr->parentPtr) {
+        stackArgv [idx++] = scanPtr->cmdName;
     }
     stackListPtr = Tcl_Merge (idx, (CONST84 char **) stackArgv);
     ckfree ((char *) stackArgv);
 
     /*
      * Check the hash table for this entry, either finding an existing or
-     * creating a new hash entry.
+     * creating a new hash entry.  An existing entry is found if a command was
+     * deleted and another created with the same name.
      */
 
     hashEntryPtr = Tcl_CreateHashEntry (&infoPtr->profDataTable,
@@ -295,27 +837,71 @@ RecordData (infoPtr, entryPtr)
         dataEntryPtr->count = 0;
         dataEntryPtr->realTime = 0;
         dataEntryPtr->cpuTime  = 0;
+        dataEntryPtr->histogram = NULL;
+        dataEntryPtr->maxTime = 0;
+        dataEntryPtr->allocBytes = 0;
+        dataEntryPtr->freeBytes = 0;
     } else {
         dataEntryPtr = (profDataEntry_t *) Tcl_GetHashValue (hashEntryPtr);
     }
 
     /*
-     * Increment the cumulative data.
+     * Increment the cumulative data.  The node's histogram is merged into
+     * the entry's, the node is left intact for snapshots.
      */
-    dataEntryPtr->count++;
-    if (infoPtr->evalMode) {
-        dataEntryPtr->realTime += entryPtr->evalRealTime;
-        dataEntryPtr->cpuTime += entryPtr->evalCpuTime;
-    } else {
-        dataEntryPtr->realTime += entryPtr->scopeRealTime;
-        dataEntryPtr->cpuTime += entryPtr->scopeCpuTime;
+    dataEntryPtr->count += nodePtr->count;
+    dataEntryPtr->realTime += nodePtr->realTime;
+    dataEntryPtr->cpuTime += nodePtr->cpuTime;
+    dataEntryPtr->allocBytes += nodePtr->allocBytes;
+    dataEntryPtr->freeBytes += nodePtr->freeBytes;
+    if (nodePtr->histogram != NULL) {
+        if (dataEntryPtr->histogram == NULL) {
+            dataEntryPtr->histogram = (unsigned int *)
+                ckalloc (PROF_HIST_SIZE * sizeof (unsigned int));
+            memcpy (dataEntryPtr->histogram, nodePtr->histogram,
+                    PROF_HIST_SIZE * sizeof (unsigned int));
+        } else {
+            for (idx = 0; idx < PROF_HIST_SIZE; idx++)
+                dataEntryPtr->histogram [idx] += nodePtr->histogram [idx];
+        }
+        if (nodePtr->maxTime > dataEntryPtr->maxTime)
+            dataEntryPtr->maxTime = nodePtr->maxTime;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * ExportProfNodes --
+ *   Record the descendants of a calling context tree node in the data table.
+ * Nodes with no calls, time or heap use, such as those that sampling only
+ * passed through, are skipped.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *   o nodePtr - The node whose descendants are recorded.
+ *-----------------------------------------------------------------------------
+ */
+static void
+ExportProfNodes (infoPtr, nodePtr)
+    profInfo_t *infoPtr;
+    profNode_t *nodePtr;
+{
+    profNode_t *childPtr;
+
+    for (childPtr = nodePtr->childPtr; childPtr != NULL;
+         childPtr = childPtr->siblingPtr) {
+        if ((childPtr->count > 0) || (childPtr->realTime != 0) ||
+            (childPtr->cpuTime != 0) || (childPtr->allocBytes != 0) ||
+            (childPtr->freeBytes != 0))
+            RecordData (infoPtr, childPtr);
+        ExportProfNodes (infoPtr, childPtr);
     }
 }
+
 
 /*-----------------------------------------------------------------------------
  * PopEntry --
- *   Pop the procedure entry from the top of the stack and record its
- * times in the data table.
+ *   Pop the procedure entry from the top of the stack and add its times to
+ * its calling context tree node.
  *
  * Parameters:
  *   o infoPtr - The global profiling info.
@@ -326,32 +912,54 @@ PopEntry (infoPtr)
     profInfo_t *infoPtr;
 {
     profEntry_t *entryPtr = infoPtr->stackPtr;
+    profNode_t *nodePtr = entryPtr->nodePtr;
 
-    RecordData (infoPtr, entryPtr);
+    nodePtr->count++;
+    if (infoPtr->evalMode) {
+        nodePtr->realTime += entryPtr->evalRealTime;
+        nodePtr->cpuTime += entryPtr->evalCpuTime;
+        nodePtr->allocBytes += entryPtr->evalAllocBytes;
+        nodePtr->freeBytes += entryPtr->evalFreeBytes;
+    } else {
+        nodePtr->realTime += entryPtr->scopeRealTime;
+        nodePtr->cpuTime += entryPtr->scopeCpuTime;
+        nodePtr->allocBytes += entryPtr->scopeAllocBytes;
+        nodePtr->freeBytes += entryPtr->scopeFreeBytes;
+    }
 
     /*
-     * Remove from the stack, reset the scope chain and free.
+     * Remove from the stack, reset the scope chain and save for reuse.
      */
     infoPtr->stackPtr = entryPtr->prevEntryPtr;
     infoPtr->stackSize--;
     infoPtr->scopeChainPtr = infoPtr->stackPtr;
 
-    ckfree ((char *) entryPtr);
+    entryPtr->prevEntryPtr = infoPtr->freeEntryPtr;
+    infoPtr->freeEntryPtr = entryPtr;
 }
 
 /*-----------------------------------------------------------------------------
  * UpdateTOSTimes --
  *   Update the time spent in the entry on the top of the stack before another
- * is pushed on top or its poped off.
+ * is pushed on top or its poped off.  With -memory and sampleHeap, the change
+ * in the heap size since it was last charged is also added to the entry, as
+ * growth or shrinkage.  Reading the heap size is expensive (mallinfo walks
+ * the malloc arenas), so it is only done when a procedure is entered or
+ * exited; the heap change of other commands is charged to the entry on the
+ * top of the stack at the next procedure boundary.
  *
  * Parameters:
  *   o infoPtr - The global profiling info.
+ *   o sampleHeap - TRUE to read the heap size with -memory.
  *-----------------------------------------------------------------------------
  */
 static void
-UpdateTOSTimes (infoPtr)
+UpdateTOSTimes (infoPtr, sampleHeap)
     profInfo_t *infoPtr;
+    int         sampleHeap;
 {
+    Tcl_WideInt allocBytes, freeBytes;
+
     /*
      * Get the current time if we haven't already.
      */
@@ -361,6 +969,24 @@ UpdateTOSTimes (infoPtr)
         TclXOSElapsedTime (&infoPtr->realTime, &infoPtr->cpuTime);
         infoPtr->updatedTimes = TRUE;
     }
+    if (infoPtr->memoryMode && sampleHeap) {
+        TclXOSheapsize (NULL, &infoPtr->heapSize, "profile");
+        allocBytes = infoPtr->heapSize - infoPtr->prevHeapSize;
+        infoPtr->prevHeapSize = infoPtr->heapSize;
+        freeBytes = 0;
+        if (allocBytes < 0) {
+            freeBytes = -allocBytes;
+            allocBytes = 0;
+        }
+        if (infoPtr->stackPtr != NULL) {
+            infoPtr->stackPtr->evalAllocBytes += allocBytes;
+            infoPtr->stackPtr->evalFreeBytes += freeBytes;
+        }
+        if (infoPtr->scopeChainPtr != NULL) {
+            infoPtr->scopeChainPtr->scopeAllocBytes += allocBytes;
+            infoPtr->scopeChainPtr->scopeFreeBytes += freeBytes;
+        }
+    }
     if (infoPtr->stackPtr != NULL) {
         infoPtr->stackPtr->evalRealTime +=
             infoPtr->realTime - infoPtr->prevRealTime;
@@ -393,8 +1019,6 @@ ProfCommandEvalSetup (infoPtr, isProcPtr)
     Tcl_CmdInfo cmdInfo;
     CallFrame *framePtr;
     int procLevel, scopeLevel, isProc;
-    Tcl_Obj *fullCmdNamePtr;
-    const char *fullCmdName;
 
     Tcl_GetCommandInfoFromToken(infoPtr->currentCmd, &cmdInfo);
     /*
@@ -417,11 +1041,6 @@ ProfCommandEvalSetup (infoPtr, isProcPtr)
 
     Tcl_SetCommandInfoFromToken(infoPtr->currentCmd, &cmdInfo);
 
-    fullCmdNamePtr = Tcl_NewObj ();
-    Tcl_GetCommandFullName (infoPtr->interp, infoPtr->currentCmd, 
-                            fullCmdNamePtr);
-    fullCmdName = Tcl_GetStringFromObj (fullCmdNamePtr, NULL);
-
     /*
      * Determine current proc and var levels.
      */
@@ -438,7 +1057,7 @@ ProfCommandEvalSetup (infoPtr, isProcPtr)
      * on the stack before we started.  Pop those entries.
      */
     if (infoPtr->stackPtr->procLevel > procLevel) {
-        UpdateTOSTimes (infoPtr);
+        UpdateTOSTimes (infoPtr, TRUE);
         do {
             if (infoPtr->stackPtr->evalLevel != UNKNOWN_LEVEL) 
                 panic (PROF_PANIC, 2);  /* Not an initial entry */
@@ -450,26 +1069,35 @@ ProfCommandEvalSetup (infoPtr, isProcPtr)
      * If this command is a procedure or if all commands are being traced,
      * handle the entry.
      */
-    isProc = (TclFindProc (iPtr, fullCmdName) != NULL);
+    isProc = (TclIsProc ((Command *) infoPtr->currentCmd) != NULL);
     if (infoPtr->commandMode || isProc) {
-        UpdateTOSTimes (infoPtr);
+        UpdateTOSTimes (infoPtr, isProc);
         if (isProc) {
-            PushEntry (infoPtr, fullCmdName, TRUE,
+            PushEntry (infoPtr, infoPtr->currentCmd, NULL, TRUE,
                        procLevel + 1, scopeLevel + 1, infoPtr->evalLevel);
         } else {
-            PushEntry (infoPtr, fullCmdName, FALSE,
+            PushEntry (infoPtr, infoPtr->currentCmd, NULL, FALSE,
                        procLevel, scopeLevel, infoPtr->evalLevel);
         }
     }
 
+    /*
+     * Don't count memory allocated for new tree nodes or stack entries
+     * against the procedure.  This is only done when the heap was just read,
+     * so the uncharged change of the commands before it isn't lost.
+     */
+    if (infoPtr->memoryMode && isProc && infoPtr->allocatedHeap) {
+        TclXOSheapsize (NULL, &infoPtr->heapSize, "profile");
+        infoPtr->prevHeapSize = infoPtr->heapSize;
+        infoPtr->allocatedHeap = FALSE;
+    }
+
     /*
      * Leaving profiler, must get time again when we reenter.
      */
     infoPtr->updatedTimes = FALSE;
 
     *isProcPtr = isProc;
-
-    Tcl_DecrRefCount (fullCmdNamePtr);
 }
 
 /*-----------------------------------------------------------------------------
@@ -488,7 +1116,11 @@ ProfCommandEvalFinishup (infoPtr, isProc)
      */
     if (infoPtr->traceHandle != NULL) {
         if (infoPtr->commandMode || isProc) {
-            UpdateTOSTimes (infoPtr);
+            UpdateTOSTimes (infoPtr, isProc);
+            if (infoPtr->latencyMode)
+                RecordLatency (infoPtr->stackPtr->nodePtr,
+                               infoPtr->realTime -
+                               infoPtr->stackPtr->startRealTime);
             PopEntry (infoPtr);
         }
     }
@@ -620,16 +1252,45 @@ CleanDataTable (infoPtr)
 {
     Tcl_HashEntry    *hashEntryPtr;
     Tcl_HashSearch   searchCookie;
+    profDataEntry_t  *dataEntryPtr;
 
     hashEntryPtr = Tcl_FirstHashEntry (&infoPtr->profDataTable,
                                        &searchCookie);
     while (hashEntryPtr != NULL) {
-        ckfree ((char *) Tcl_GetHashValue (hashEntryPtr));
+        dataEntryPtr = (profDataEntry_t *) Tcl_GetHashValue (hashEntryPtr);
+        if (dataEntryPtr->histogram != NULL)
+            ckfree ((char *) dataEntryPtr->histogram);
+        ckfree ((char *) dataEntryPtr);
         Tcl_DeleteHashEntry (hashEntryPtr);
         hashEntryPtr = Tcl_NextHashEntry (&searchCookie);
     }
 }
 
+/*-----------------------------------------------------------------------------
+ * CleanProfData --
+ *    Release all of the profile data, the data table, the calling context
+ * tree and the free stack entries.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+CleanProfData (infoPtr)
+    profInfo_t *infoPtr;
+{
+    profEntry_t *entryPtr;
+
+    CleanDataTable (infoPtr);
+    FreeProfNodes (&infoPtr->rootNode);
+
+    while (infoPtr->freeEntryPtr != NULL) {
+        entryPtr = infoPtr->freeEntryPtr;
+        infoPtr->freeEntryPtr = entryPtr->prevEntryPtr;
+        ckfree ((char *) entryPtr);
+    }
+}
+
 /*-----------------------------------------------------------------------------
  * InitializeProcStack --
  *    Recursive procedure to initialize the procedure call stack so its in the
@@ -654,6 +1315,7 @@ InitializeProcStack (infoPtr, framePtr)
     
        
     PushEntry (infoPtr,
+               NULL,
                Tcl_GetStringFromObj (framePtr->objv [0], NULL),
                TRUE,
                infoPtr->stackPtr->procLevel + 1,
@@ -671,19 +1333,24 @@ InitializeProcStack (infoPtr, framePtr)
  *     procs.
  *   o evalMode - TRUE if eval stack is to be used to log entries.  FALSE if
  *     the scope stack is to be used.
+ *   o latencyMode - TRUE if a histogram of the duration of the calls is to
+ *     be kept.
+ *   o memoryMode - TRUE if the change in heap size is to be tracked.
  *-----------------------------------------------------------------------------
  */
 static void
-TurnOnProfiling (infoPtr, commandMode, evalMode)
+TurnOnProfiling (infoPtr, commandMode, evalMode, latencyMode, memoryMode)
     profInfo_t *infoPtr;
     int         commandMode;
     int         evalMode;
+    int         latencyMode;
+    int         memoryMode;
 {
     Interp *iPtr = (Interp *) infoPtr->interp;
     int scopeLevel;
     profEntry_t *scanPtr;
 
-    CleanDataTable (infoPtr);
+    CleanProfData (infoPtr);
 
     infoPtr->traceHandle =
         Tcl_CreateObjTrace (infoPtr->interp, 0,
@@ -691,6 +1358,8 @@ TurnOnProfiling (infoPtr, commandMode, evalMode)
                          (ClientData) infoPtr, NULL);
     infoPtr->commandMode = commandMode;
     infoPtr->evalMode = evalMode;
+    infoPtr->latencyMode = latencyMode;
+    infoPtr->memoryMode = memoryMode;
     infoPtr->realTime = 0;
     infoPtr->cpuTime = 0;
     infoPtr->prevRealTime = 0;
@@ -700,7 +1369,7 @@ TurnOnProfiling (infoPtr, commandMode, evalMode)
     /*
      * Add entry for global context, then add in current procedures.
      */
-    PushEntry (infoPtr, "<global>", TRUE, 0, 0, 0);
+    PushEntry (infoPtr, NULL, "<global>", TRUE, 0, 0, 0);
     InitializeProcStack (infoPtr, ((Interp *) infoPtr->interp)->framePtr);
 
     /*
@@ -720,86 +1389,749 @@ TurnOnProfiling (infoPtr, commandMode, evalMode)
     infoPtr->scopeChainPtr = scanPtr;
 
     /*
-     * Get the time we started.
+     * Get the time and heap size we started with.
      */
     TclXOSElapsedTime (&infoPtr->realTime, &infoPtr->cpuTime);
+    if (memoryMode) {
+        TclXOSheapsize (NULL, &infoPtr->heapSize, "profile");
+        infoPtr->prevHeapSize = infoPtr->heapSize;
+        infoPtr->allocatedHeap = FALSE;
+    }
 }
 
 /*-----------------------------------------------------------------------------
- * DeleteProfTrace --
- *   Delete the profile trace and clean up the stack, logging all procs
- * as if they had exited.  Data table must still be available.
- *
- * Parameters:
- *   o infoPtr - The global profiling info.
+ * SampleTick --
+ *   Called from the signal handler on each tick of the profiling timer.
+ * Just arranges for the sample to be recorded when it is safe to look at the
+ * interpreter's stack.
  *-----------------------------------------------------------------------------
  */
 static void
-DeleteProfTrace (infoPtr)
-    profInfo_t *infoPtr;
+SampleTick ()
 {
-    Tcl_DeleteTrace (infoPtr->interp, infoPtr->traceHandle);
-    infoPtr->traceHandle = NULL;
+    Tcl_AsyncHandler asyncHandler = sampleAsyncHandler;
 
-    UpdateTOSTimes (infoPtr);
-    while (infoPtr->stackPtr != NULL) {
-        PopEntry (infoPtr);
-    }
+    if (asyncHandler != NULL)
+        Tcl_AsyncMark (asyncHandler);
 }
 
 /*-----------------------------------------------------------------------------
- * TurnOffProfiling --
- *   Turn off profiling.  Dump the table data to an array variable.  Entries
- * will be deleted as they are dumped to limit memory utilization.
+ * SampleFrameNode --
+ *    Recursive procedure to find the calling context tree node of a procedure
+ * call frame, adding nodes for the frame and its callers as needed.  Frames
+ * that are not procedure calls, such as namespace eval, are skipped.
  *
  * Parameters:
- *   o interp - Pointer to the interprer.
  *   o infoPtr - The global profiling info.
- *   o varName - The name of the variable to save the data in.
+ *   o framePtr - The frame to find the node of.  The chain of callers is
+ *     followed in either the eval or scope stack, based on the -eval option.
  * Returns:
- *   TCL_OK or TCL_ERROR.
- * FIX: Should take Tcl_Obj for varName.
+ *   A pointer to the node.
  *-----------------------------------------------------------------------------
  */
-static int
-TurnOffProfiling (interp, infoPtr, varName)
-    Tcl_Interp *interp;
+static profNode_t *
+SampleFrameNode (infoPtr, framePtr)
     profInfo_t *infoPtr;
-    char       *varName;
+    CallFrame  *framePtr;
 {
-    Tcl_HashEntry *hashEntryPtr;
-    Tcl_HashSearch searchCookie;
-    profDataEntry_t *dataEntryPtr;
-    CONST84 char *dataArgv [3];
-    char countBuf [32], realTimeBuf [32], cpuTimeBuf [32], *dataListPtr;
+    profNode_t *parentPtr;
+    Tcl_Command cmd;
 
-    DeleteProfTrace (infoPtr);
+    if (framePtr == NULL)
+        return FindProfNode (infoPtr, &infoPtr->rootNode, NULL, "<global>");
 
-    dataArgv [0] = countBuf;
-    dataArgv [1] = realTimeBuf;
-    dataArgv [2] = cpuTimeBuf;
+    parentPtr = SampleFrameNode (infoPtr, infoPtr->evalMode ?
+                                 framePtr->callerPtr : framePtr->callerVarPtr);
+    if (!(framePtr->isProcCallFrame & FRAME_IS_PROC) ||
+        (framePtr->objv == NULL))
+        return parentPtr;
 
-    Tcl_UnsetVar (interp, varName, 0);
-    hashEntryPtr = Tcl_FirstHashEntry (&infoPtr->profDataTable,
+    /*
+     * Lambdas have no command, they are known by the command that applied
+     * them.
+     */
+    cmd = (Tcl_Command) framePtr->procPtr->cmdPtr;
+    return FindProfNode (infoPtr, parentPtr, cmd,
+                         (cmd != NULL) ? NULL :
+                         Tcl_GetStringFromObj (framePtr->objv [0], NULL));
+}
+
+/*-----------------------------------------------------------------------------
+ * RecordSample --
+ *   Async handler that records a sample of the interpreter's procedure
+ * stack.  The real and CPU time since the previous sample is charged to the
+ * procedure on the top of the stack.
+ *
+ * Parameters:
+ *   o clientData - The global profiling info.
+ *   o interp - The interpreter that is running, if any.  Not used, the
+ *     interpreter being profiled is sampled even when it is idle.
+ *   o code - The completion code of the last command.
+ * Returns:
+ *   The completion code, unchanged.
+ *-----------------------------------------------------------------------------
+ */
+static int
+RecordSample (clientData, interp, code)
+    ClientData  clientData;
+    Tcl_Interp *interp;
+    int         code;
+{
+    profInfo_t *infoPtr = (profInfo_t *) clientData;
+    Interp *iPtr = (Interp *) infoPtr->interp;
+    profNode_t *nodePtr;
+
+    if (infoPtr->sampleUsec == 0)
+        return code;
+
+    infoPtr->prevRealTime = infoPtr->realTime;
+    infoPtr->prevCpuTime = infoPtr->cpuTime;
+    TclXOSElapsedTime (&infoPtr->realTime, &infoPtr->cpuTime);
+
+    nodePtr = SampleFrameNode (infoPtr, infoPtr->evalMode ? iPtr->framePtr :
+                               iPtr->varFramePtr);
+    nodePtr->count++;
+    nodePtr->realTime += infoPtr->realTime - infoPtr->prevRealTime;
+    nodePtr->cpuTime += infoPtr->cpuTime - infoPtr->prevCpuTime;
+
+    return code;
+}
+
+/*-----------------------------------------------------------------------------
+ * TurnOnSampling --
+ *    Turn on sampling profiling.  Rather than tracing every command, the
+ * procedure stack is recorded on each tick of a timer that counts the CPU
+ * time used by the process.
+ *
+ * Parameters:
+ *   o interp - Errors are returned in result.
+ *   o infoPtr - The global profiling info.
+ *   o sampleUsec - The interval between samples, in microseconds.
+ *   o evalMode - TRUE if eval stack is to be used to log entries.  FALSE if
+ *     the scope stack is to be used.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+TurnOnSampling (interp, infoPtr, sampleUsec, evalMode)
+    Tcl_Interp *interp;
+    profInfo_t *infoPtr;
+    long        sampleUsec;
+    int         evalMode;
+{
+    Tcl_MutexLock (&sampleMutex);
+    if (sampleAsyncHandler != NULL) {
+        Tcl_MutexUnlock (&sampleMutex);
+        TclX_AppendObjResult (interp, "sampling profiling is already ",
+                              "enabled in another interpreter",
+                              (char *) NULL);
+        return TCL_ERROR;
+    }
+
+    CleanProfData (infoPtr);
+
+    infoPtr->commandMode = FALSE;
+    infoPtr->evalMode = evalMode;
+    infoPtr->latencyMode = FALSE;
+    infoPtr->memoryMode = FALSE;
+    infoPtr->sampleUsec = sampleUsec;
+    if (infoPtr->sampleHandler == NULL)
+        infoPtr->sampleHandler = Tcl_AsyncCreate (RecordSample,
+                                                  (ClientData) infoPtr);
+    sampleAsyncHandler = infoPtr->sampleHandler;
+    TclXOSElapsedTime (&infoPtr->realTime, &infoPtr->cpuTime);
+
+    if (TclXOSsetproftimer (interp, sampleUsec, SampleTick,
+                            "profile -sample") != TCL_OK) {
+        sampleAsyncHandler = NULL;
+        Tcl_MutexUnlock (&sampleMutex);
+        infoPtr->sampleUsec = 0;
+        return TCL_ERROR;
+    }
+    Tcl_MutexUnlock (&sampleMutex);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * TurnOffSampling --
+ *   Stop the profiling timer.  The async handler is kept, as a tick may still
+ * mark it, and any sample it records is dropped.  The data collected is left
+ * in the calling context tree.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+TurnOffSampling (infoPtr)
+    profInfo_t *infoPtr;
+{
+    Tcl_MutexLock (&sampleMutex);
+    TclXOSsetproftimer (infoPtr->interp, 0, NULL, NULL);
+    sampleAsyncHandler = NULL;
+    Tcl_MutexUnlock (&sampleMutex);
+
+    infoPtr->sampleUsec = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * DeleteProfTrace --
+ *   Delete the profile trace and clean up the stack, logging all procs
+ * as if they had exited.  Data table must still be available.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+DeleteProfTrace (infoPtr)
+    profInfo_t *infoPtr;
+{
+    Tcl_DeleteTrace (infoPtr->interp, infoPtr->traceHandle);
+    infoPtr->traceHandle = NULL;
+
+    UpdateTOSTimes (infoPtr, TRUE);
+    while (infoPtr->stackPtr != NULL) {
+        PopEntry (infoPtr);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * AppendVarint --
+ *   Append an unsigned integer to a buffer in protocol buffer varint
+ * encoding.
+ *
+ * Parameters:
+ *   o bufPtr - The buffer to append to.
+ *   o value - The value to encode.
+ *-----------------------------------------------------------------------------
+ */
+static void
+AppendVarint (bufPtr, value)
+    Tcl_DString  *bufPtr;
+    Tcl_WideUInt  value;
+{
+    char bytes [10];
+    int idx = 0;
+
+    while (value >= 0x80) {
+        bytes [idx++] = (char) ((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    bytes [idx++] = (char) value;
+    Tcl_DStringAppend (bufPtr, bytes, idx);
+}
+
+/*-----------------------------------------------------------------------------
+ * AppendVarintField --
+ *   Append a protocol buffer varint field to a buffer.
+ *
+ * Parameters:
+ *   o bufPtr - The buffer to append to.
+ *   o field - The field number.
+ *   o value - The value of the field.
+ *-----------------------------------------------------------------------------
+ */
+static void
+AppendVarintField (bufPtr, field, value)
+    Tcl_DString  *bufPtr;
+    int           field;
+    Tcl_WideUInt  value;
+{
+    AppendVarint (bufPtr, (Tcl_WideUInt) (field << 3));
+    AppendVarint (bufPtr, value);
+}
+
+/*-----------------------------------------------------------------------------
+ * AppendBytesField --
+ *   Append a protocol buffer length delimited field, a string, embedded
+ * message or packed repeated field, to a buffer.
+ *
+ * Parameters:
+ *   o bufPtr - The buffer to append to.
+ *   o field - The field number.
+ *   o bytes - The contents of the field.
+ *   o length - The number of bytes in the contents, or -1 if it is a null
+ *     terminated string.
+ *-----------------------------------------------------------------------------
+ */
+static void
+AppendBytesField (bufPtr, field, bytes, length)
+    Tcl_DString *bufPtr;
+    int          field;
+    const char  *bytes;
+    int          length;
+{
+    if (length < 0)
+        length = strlen (bytes);
+    AppendVarint (bufPtr, (Tcl_WideUInt) ((field << 3) | 2));
+    AppendVarint (bufPtr, (Tcl_WideUInt) length);
+    Tcl_DStringAppend (bufPtr, bytes, length);
+}
+
+/*-----------------------------------------------------------------------------
+ * WriteFolded --
+ *   Recursively write the descendants of a calling context tree node in
+ * collapsed stack (folded) format, used by flame graph tools.  Each line is
+ * the stack, outermost first, separated by `;', followed by the CPU time in
+ * microseconds spent with it on top.  Stacks with no CPU time are not
+ * written.  The format has no quoting, so `;' and line ends in command names
+ * are written as `_'.
+ *
+ * Parameters:
+ *   o channel - The channel to write to.
+ *   o nodePtr - The node whose descendants are written.
+ *   o pathPtr - The stack of the node, it is restored before returning.
+ * Returns:
+ *   TCL_OK or TCL_ERROR if a write failed, with errno set.
+ *-----------------------------------------------------------------------------
+ */
+static int
+WriteFolded (channel, nodePtr, pathPtr)
+    Tcl_Channel  channel;
+    profNode_t  *nodePtr;
+    Tcl_DString *pathPtr;
+{
+    profNode_t *childPtr;
+    int pathLen = Tcl_DStringLength (pathPtr);
+    Tcl_WideInt weight;
+    char numBuf [32], *namePtr;
+    int nameIdx;
+
+    for (childPtr = nodePtr->childPtr; childPtr != NULL;
+         childPtr = childPtr->siblingPtr) {
+        if (pathLen > 0)
+            Tcl_DStringAppend (pathPtr, ";", 1);
+        nameIdx = Tcl_DStringLength (pathPtr);
+        Tcl_DStringAppend (pathPtr, childPtr->cmdName, -1);
+        for (namePtr = Tcl_DStringValue (pathPtr) + nameIdx; *namePtr != '\0';
+             namePtr++) {
+            if ((*namePtr == ';') || (*namePtr == '\n') || (*namePtr == '\r'))
+                *namePtr = '_';
+        }
+
+        weight = childPtr->cpuTime / 1000;
+        if (weight > 0) {
+            sprintf (numBuf, " %" TCL_LL_MODIFIER "d\n", weight);
+            if ((Tcl_WriteChars (channel, Tcl_DStringValue (pathPtr),
+                                 Tcl_DStringLength (pathPtr)) < 0) ||
+                (Tcl_WriteChars (channel, numBuf, -1) < 0))
+                return TCL_ERROR;
+        }
+        if (WriteFolded (channel, childPtr, pathPtr) != TCL_OK)
+            return TCL_ERROR;
+        Tcl_DStringSetLength (pathPtr, pathLen);
+    }
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * PprofString --
+ *   Get the index of a string in the pprof string table, adding it if its
+ * not already there.
+ *
+ * Parameters:
+ *   o pprofPtr - The pprof encoding state.
+ *   o str - The string.
+ * Returns:
+ *   The string table index.
+ *-----------------------------------------------------------------------------
+ */
+static int
+PprofString (pprofPtr, str)
+    pprofInfo_t *pprofPtr;
+    const char  *str;
+{
+    Tcl_HashEntry *hashEntryPtr;
+    int newEntry;
+
+    hashEntryPtr = Tcl_CreateHashEntry (&pprofPtr->stringTable, str,
+                                        &newEntry);
+    if (newEntry) {
+        Tcl_SetHashValue (hashEntryPtr,
+                          (ClientData) (intptr_t) pprofPtr->numStrings);
+        AppendBytesField (&pprofPtr->strings, PPROF_PROFILE_STRING_TABLE,
+                          str, -1);
+        return pprofPtr->numStrings++;
+    }
+    return (int) (intptr_t) Tcl_GetHashValue (hashEntryPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * PprofFunction --
+ *   Get the id of the pprof function and location for a procedure or
+ * command name, adding them if they are not already defined.
+ *
+ * Parameters:
+ *   o pprofPtr - The pprof encoding state.
+ *   o name - The procedure or command name.
+ * Returns:
+ *   The function and location id.
+ *-----------------------------------------------------------------------------
+ */
+static int
+PprofFunction (pprofPtr, name)
+    pprofInfo_t *pprofPtr;
+    const char  *name;
+{
+    Tcl_HashEntry *hashEntryPtr;
+    int newEntry;
+    int id, nameIdx;
+    Tcl_DString message, line;
+
+    hashEntryPtr = Tcl_CreateHashEntry (&pprofPtr->functionTable, name,
+                                        &newEntry);
+    if (!newEntry)
+        return (int) (intptr_t) Tcl_GetHashValue (hashEntryPtr);
+
+    id = ++pprofPtr->numFunctions;
+    Tcl_SetHashValue (hashEntryPtr, (ClientData) (intptr_t) id);
+    nameIdx = PprofString (pprofPtr, name);
+
+    Tcl_DStringInit (&message);
+    AppendVarintField (&message, PPROF_FUNCTION_ID, id);
+    AppendVarintField (&message, PPROF_FUNCTION_NAME, nameIdx);
+    AppendVarintField (&message, PPROF_FUNCTION_SYSTEM_NAME, nameIdx);
+    AppendBytesField (&pprofPtr->functions, PPROF_PROFILE_FUNCTION,
+                      Tcl_DStringValue (&message),
+                      Tcl_DStringLength (&message));
+
+    Tcl_DStringSetLength (&message, 0);
+    Tcl_DStringInit (&line);
+    AppendVarintField (&line, PPROF_LINE_FUNCTION_ID, id);
+    AppendVarintField (&message, PPROF_LOCATION_ID, id);
+    AppendBytesField (&message, PPROF_LOCATION_LINE,
+                      Tcl_DStringValue (&line), Tcl_DStringLength (&line));
+    AppendBytesField (&pprofPtr->functions, PPROF_PROFILE_LOCATION,
+                      Tcl_DStringValue (&message),
+                      Tcl_DStringLength (&message));
+
+    Tcl_DStringFree (&line);
+    Tcl_DStringFree (&message);
+    return id;
+}
+
+/*-----------------------------------------------------------------------------
+ * PprofSamples --
+ *   Recursively encode the descendants of a calling context tree node as
+ * pprof samples.  The values of a sample are the count, real time and CPU
+ * time, followed by the heap growth and shrinkage with -memory.
+ *
+ * Parameters:
+ *   o pprofPtr - The pprof encoding state.  The stack contains the function
+ *     ids of the path to the node.
+ *   o nodePtr - The node whose descendants are encoded.
+ *   o depth - The depth of the node.
+ *-----------------------------------------------------------------------------
+ */
+static void
+PprofSamples (pprofPtr, nodePtr, depth)
+    pprofInfo_t *pprofPtr;
+    profNode_t  *nodePtr;
+    int          depth;
+{
+    profNode_t *childPtr;
+    Tcl_DString message, packed;
+    int idx;
+
+    if (depth >= pprofPtr->stackSize) {
+        pprofPtr->stackSize = (pprofPtr->stackSize == 0) ? 32 :
+            pprofPtr->stackSize * 2;
+        pprofPtr->stack = (Tcl_WideUInt *)
+            ckrealloc ((char *) pprofPtr->stack,
+                       pprofPtr->stackSize * sizeof (Tcl_WideUInt));
+    }
+
+    for (childPtr = nodePtr->childPtr; childPtr != NULL;
+         childPtr = childPtr->siblingPtr) {
+        pprofPtr->stack [depth] = PprofFunction (pprofPtr,
+                                                 childPtr->cmdName);
+        if (childPtr->count > 0) {
+            /*
+             * Locations are listed with the top of the stack first.
+             */
+            Tcl_DStringInit (&message);
+            Tcl_DStringInit (&packed);
+            for (idx = depth; idx >= 0; idx--) {
+                AppendVarint (&packed, pprofPtr->stack [idx]);
+            }
+            AppendBytesField (&message, PPROF_SAMPLE_LOCATION_ID,
+                              Tcl_DStringValue (&packed),
+                              Tcl_DStringLength (&packed));
+
+            Tcl_DStringSetLength (&packed, 0);
+            AppendVarint (&packed, (Tcl_WideUInt) childPtr->count);
+            AppendVarint (&packed, (Tcl_WideUInt) childPtr->realTime);
+            AppendVarint (&packed, (Tcl_WideUInt) childPtr->cpuTime);
+            if (pprofPtr->memoryMode) {
+                AppendVarint (&packed, (Tcl_WideUInt) childPtr->allocBytes);
+                AppendVarint (&packed, (Tcl_WideUInt) childPtr->freeBytes);
+            }
+            AppendBytesField (&message, PPROF_SAMPLE_VALUE,
+                              Tcl_DStringValue (&packed),
+                              Tcl_DStringLength (&packed));
+
+            AppendBytesField (&pprofPtr->samples, PPROF_PROFILE_SAMPLE,
+                              Tcl_DStringValue (&message),
+                              Tcl_DStringLength (&message));
+            Tcl_DStringFree (&packed);
+            Tcl_DStringFree (&message);
+        }
+        PprofSamples (pprofPtr, childPtr, depth + 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * WritePprof --
+ *   Write the calling context tree as an uncompressed pprof protocol buffer
+ * profile.
+ *
+ * Parameters:
+ *   o channel - The channel to write to, in binary mode.
+ *   o infoPtr - The global profiling info.
+ *   o sampleUsec - The sample interval if the data was sampled, zero if it
+ *     was traced.
+ * Returns:
+ *   TCL_OK or TCL_ERROR if the write failed, with errno set.
+ *-----------------------------------------------------------------------------
+ */
+static int
+WritePprof (channel, infoPtr, sampleUsec)
+    Tcl_Channel  channel;
+    profInfo_t  *infoPtr;
+    long         sampleUsec;
+{
+    const char *valueTypes [] = {
+        "calls", "count", "real", "nanoseconds", "cpu", "nanoseconds",
+        "alloc_space", "bytes", "free_space", "bytes"};
+    pprofInfo_t pprof;
+    Tcl_DString profile, message;
+    int idx, numValueTypes, result;
+
+    Tcl_InitHashTable (&pprof.stringTable, TCL_STRING_KEYS);
+    Tcl_InitHashTable (&pprof.functionTable, TCL_STRING_KEYS);
+    pprof.numStrings = 0;
+    pprof.numFunctions = 0;
+    Tcl_DStringInit (&pprof.strings);
+    Tcl_DStringInit (&pprof.functions);
+    Tcl_DStringInit (&pprof.samples);
+    pprof.stack = NULL;
+    pprof.stackSize = 0;
+    pprof.memoryMode = infoPtr->memoryMode;
+    Tcl_DStringInit (&profile);
+    Tcl_DStringInit (&message);
+
+    /*
+     * The string table must start with the empty string.
+     */
+    PprofString (&pprof, "");
+    if (sampleUsec != 0)
+        valueTypes [0] = "samples";
+    numValueTypes = infoPtr->memoryMode ? 10 : 6;
+
+    for (idx = 0; idx < numValueTypes; idx += 2) {
+        Tcl_DStringSetLength (&message, 0);
+        AppendVarintField (&message, PPROF_VALUE_TYPE_TYPE,
+                           PprofString (&pprof, valueTypes [idx]));
+        AppendVarintField (&message, PPROF_VALUE_TYPE_UNIT,
+                           PprofString (&pprof, valueTypes [idx + 1]));
+        AppendBytesField (&profile, PPROF_PROFILE_SAMPLE_TYPE,
+                          Tcl_DStringValue (&message),
+                          Tcl_DStringLength (&message));
+    }
+    AppendVarintField (&profile, PPROF_PROFILE_DEFAULT_SAMPLE_TYPE,
+                       PprofString (&pprof, "cpu"));
+    if (sampleUsec != 0) {
+        Tcl_DStringSetLength (&message, 0);
+        AppendVarintField (&message, PPROF_VALUE_TYPE_TYPE,
+                           PprofString (&pprof, "cpu"));
+        AppendVarintField (&message, PPROF_VALUE_TYPE_UNIT,
+                           PprofString (&pprof, "nanoseconds"));
+        AppendBytesField (&profile, PPROF_PROFILE_PERIOD_TYPE,
+                          Tcl_DStringValue (&message),
+                          Tcl_DStringLength (&message));
+        AppendVarintField (&profile, PPROF_PROFILE_PERIOD,
+                           (Tcl_WideUInt) sampleUsec * 1000);
+    }
+
+    PprofSamples (&pprof, &infoPtr->rootNode, 0);
+
+    result = TCL_OK;
+    if ((Tcl_Write (channel, Tcl_DStringValue (&profile),
+                    Tcl_DStringLength (&profile)) < 0) ||
+        (Tcl_Write (channel, Tcl_DStringValue (&pprof.samples),
+                    Tcl_DStringLength (&pprof.samples)) < 0) ||
+        (Tcl_Write (channel, Tcl_DStringValue (&pprof.functions),
+                    Tcl_DStringLength (&pprof.functions)) < 0) ||
+        (Tcl_Write (channel, Tcl_DStringValue (&pprof.strings),
+                    Tcl_DStringLength (&pprof.strings)) < 0))
+        result = TCL_ERROR;
+
+    Tcl_DeleteHashTable (&pprof.stringTable);
+    Tcl_DeleteHashTable (&pprof.functionTable);
+    Tcl_DStringFree (&pprof.strings);
+    Tcl_DStringFree (&pprof.functions);
+    Tcl_DStringFree (&pprof.samples);
+    if (pprof.stack != NULL)
+        ckfree ((char *) pprof.stack);
+    Tcl_DStringFree (&profile);
+    Tcl_DStringFree (&message);
+    return result;
+}
+
+/*-----------------------------------------------------------------------------
+ * TurnOffProfiling --
+ *   Turn off profiling.  Write the calling context tree to the export files
+ * and dump the table data to an array variable.  Entries will be deleted as
+ * they are dumped to limit memory utilization.
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o infoPtr - The global profiling info.
+ *   o varName - The name of the variable to save the data in, or NULL if
+ *     the data is only exported to files.
+ *   o foldedChan - If not NULL, a channel to write collapsed stack data to.
+ *     It is closed.
+ *   o pprofChan - If not NULL, a channel to write a pprof profile to.  It is
+ *     closed.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ * FIX: Should take Tcl_Obj for varName.
+ *-----------------------------------------------------------------------------
+ */
+static int
+TurnOffProfiling (interp, infoPtr, varName, foldedChan, pprofChan)
+    Tcl_Interp  *interp;
+    profInfo_t  *infoPtr;
+    char        *varName;
+    Tcl_Channel  foldedChan;
+    Tcl_Channel  pprofChan;
+{
+    Tcl_DString path;
+    long sampleUsec = infoPtr->sampleUsec;
+    int result = TCL_OK;
+
+    StopAutoDump (infoPtr);
+    if (sampleUsec != 0) {
+        TurnOffSampling (infoPtr);
+    } else {
+        DeleteProfTrace (infoPtr);
+    }
+
+    /*
+     * Write the export files directly from the calling context tree.
+     */
+    if (foldedChan != NULL) {
+        Tcl_DStringInit (&path);
+        if (WriteFolded (foldedChan, &infoPtr->rootNode, &path) != TCL_OK) {
+            TclX_AppendObjResult (interp, "error writing folded profile: ",
+                                  Tcl_PosixError (interp), (char *) NULL);
+            result = TCL_ERROR;
+        }
+        Tcl_DStringFree (&path);
+        if (Tcl_Close ((result == TCL_OK) ? interp : NULL,
+                       foldedChan) != TCL_OK)
+            result = TCL_ERROR;
+    }
+    if (pprofChan != NULL) {
+        if ((result == TCL_OK) &&
+            (WritePprof (pprofChan, infoPtr, sampleUsec) != TCL_OK)) {
+            TclX_AppendObjResult (interp, "error writing pprof profile: ",
+                                  Tcl_PosixError (interp), (char *) NULL);
+            result = TCL_ERROR;
+        }
+        if (Tcl_Close ((result == TCL_OK) ? interp : NULL,
+                       pprofChan) != TCL_OK)
+            result = TCL_ERROR;
+    }
+    if ((result != TCL_OK) || (varName == NULL)) {
+        FreeProfNodes (&infoPtr->rootNode);
+        return result;
+    }
+
+    /*
+     * Build the stack lists from the calling context tree.
+     */
+    ExportProfNodes (infoPtr, &infoPtr->rootNode);
+    FreeProfNodes (&infoPtr->rootNode);
+
+    Tcl_UnsetVar (interp, varName, 0);
+    return DumpDataTable (interp, infoPtr, varName, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ * DumpDataTable --
+ *   Dump the table data to an array variable or a list.  Entries are deleted
+ * as they are dumped to limit memory utilization.
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o infoPtr - The global profiling info.
+ *   o varName - The name of the array variable to save the data in, or NULL.
+ *   o listPtr - If varName is NULL, the list to append the stack list and
+ *     data of each entry to, in the form returned by array get.
+ * Returns:
+ *   TCL_OK or TCL_ERROR, in which case the table is emptied.
+ *-----------------------------------------------------------------------------
+ */
+static int
+DumpDataTable (interp, infoPtr, varName, listPtr)
+    Tcl_Interp *interp;
+    profInfo_t *infoPtr;
+    char       *varName;
+    Tcl_Obj    *listPtr;
+{
+    Tcl_HashEntry *hashEntryPtr;
+    Tcl_HashSearch searchCookie;
+    profDataEntry_t *dataEntryPtr;
+    Tcl_Obj *dataObjv [PROF_DATA_MAX], *dataPtr;
+    int dataObjc;
+    char *stackList;
+
+    hashEntryPtr = Tcl_FirstHashEntry (&infoPtr->profDataTable,
                                        &searchCookie);
     while (hashEntryPtr != NULL) {
         dataEntryPtr = 
             (profDataEntry_t *) Tcl_GetHashValue (hashEntryPtr);
 
-        sprintf (countBuf,    "%ld", (long) dataEntryPtr->count);
-        sprintf (realTimeBuf, "%ld", (long) dataEntryPtr->realTime);
-        sprintf (cpuTimeBuf,  "%ld", (long) dataEntryPtr->cpuTime);
+        dataObjv [0] = Tcl_NewWideIntObj (dataEntryPtr->count);
+        dataObjv [1] = Tcl_NewWideIntObj (dataEntryPtr->realTime);
+        dataObjv [2] = Tcl_NewWideIntObj (dataEntryPtr->cpuTime);
+        dataObjc = PROF_DATA_BASIC;
+        if (infoPtr->latencyMode) {
+            dataObjv [3] = HistogramPercentile (dataEntryPtr->histogram,
+                                                dataEntryPtr->maxTime, 50);
+            dataObjv [4] = HistogramPercentile (dataEntryPtr->histogram,
+                                                dataEntryPtr->maxTime, 90);
+            dataObjv [5] = HistogramPercentile (dataEntryPtr->histogram,
+                                                dataEntryPtr->maxTime, 99);
+            dataObjv [6] = Tcl_NewWideIntObj (dataEntryPtr->maxTime);
+            dataObjc += PROF_DATA_LATENCY;
+        }
+        if (infoPtr->memoryMode) {
+            dataObjv [dataObjc++] =
+                Tcl_NewWideIntObj (dataEntryPtr->allocBytes);
+            dataObjv [dataObjc++] =
+                Tcl_NewWideIntObj (dataEntryPtr->freeBytes);
+        }
 
-        dataListPtr = Tcl_Merge (3, dataArgv);
+        dataPtr = Tcl_NewListObj (dataObjc, dataObjv);
+        stackList = Tcl_GetHashKey (&infoPtr->profDataTable, hashEntryPtr);
 
-        if (Tcl_SetVar2 (interp, varName,
-                         Tcl_GetHashKey (&infoPtr->profDataTable,
-                                         hashEntryPtr),
-                         dataListPtr, TCL_LEAVE_ERR_MSG) == NULL) {
-            ckfree (dataListPtr);
-            return TCL_ERROR;
+        if (varName != NULL) {
+            if (Tcl_SetVar2Ex (interp, varName, stackList, dataPtr,
+                               TCL_LEAVE_ERR_MSG) == NULL) {
+                CleanDataTable (infoPtr);
+                return TCL_ERROR;
+            }
+        } else {
+            Tcl_ListObjAppendElement (NULL, listPtr,
+                                      Tcl_NewStringObj (stackList, -1));
+            Tcl_ListObjAppendElement (NULL, listPtr, dataPtr);
         }
-        ckfree (dataListPtr);
+        if (dataEntryPtr->histogram != NULL)
+            ckfree ((char *) dataEntryPtr->histogram);
         ckfree ((char *) dataEntryPtr);
         Tcl_DeleteHashEntry (hashEntryPtr);
 
@@ -809,11 +2141,646 @@ TurnOffProfiling (interp, infoPtr, varName)
     return TCL_OK;
 }
 
+/*-----------------------------------------------------------------------------
+ * FlushEntryTimes --
+ *   Add the times and heap use of the procedures and commands on the stack to
+ * their calling context tree nodes, so a snapshot includes the time spent in
+ * calls that are still running.  The values in the entries are cleared, their
+ * calls are counted when they are popped.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+FlushEntryTimes (infoPtr)
+    profInfo_t *infoPtr;
+{
+    profEntry_t *entryPtr;
+
+    UpdateTOSTimes (infoPtr, TRUE);
+    for (entryPtr = infoPtr->stackPtr; entryPtr != NULL;
+         entryPtr = entryPtr->prevEntryPtr) {
+        if (infoPtr->evalMode) {
+            entryPtr->nodePtr->realTime += entryPtr->evalRealTime;
+            entryPtr->nodePtr->cpuTime += entryPtr->evalCpuTime;
+            entryPtr->nodePtr->allocBytes += entryPtr->evalAllocBytes;
+            entryPtr->nodePtr->freeBytes += entryPtr->evalFreeBytes;
+        } else {
+            entryPtr->nodePtr->realTime += entryPtr->scopeRealTime;
+            entryPtr->nodePtr->cpuTime += entryPtr->scopeCpuTime;
+            entryPtr->nodePtr->allocBytes += entryPtr->scopeAllocBytes;
+            entryPtr->nodePtr->freeBytes += entryPtr->scopeFreeBytes;
+        }
+        entryPtr->evalRealTime = 0;
+        entryPtr->evalCpuTime = 0;
+        entryPtr->scopeRealTime = 0;
+        entryPtr->scopeCpuTime = 0;
+        entryPtr->evalAllocBytes = 0;
+        entryPtr->evalFreeBytes = 0;
+        entryPtr->scopeAllocBytes = 0;
+        entryPtr->scopeFreeBytes = 0;
+    }
+
+    /*
+     * The time of the next trace is measured from here.
+     */
+    infoPtr->updatedTimes = FALSE;
+}
+
+/*-----------------------------------------------------------------------------
+ * ResetProfNodes --
+ *   Clear the counters of the descendants of a calling context tree node.
+ * The nodes are kept, as entries on the stack refer to them.
+ *
+ * Parameters:
+ *   o nodePtr - The node whose descendants are cleared.
+ *-----------------------------------------------------------------------------
+ */
+static void
+ResetProfNodes (nodePtr)
+    profNode_t *nodePtr;
+{
+    profNode_t *childPtr;
+
+    for (childPtr = nodePtr->childPtr; childPtr != NULL;
+         childPtr = childPtr->siblingPtr) {
+        childPtr->count = 0;
+        childPtr->realTime = 0;
+        childPtr->cpuTime = 0;
+        childPtr->maxTime = 0;
+        childPtr->allocBytes = 0;
+        childPtr->freeBytes = 0;
+        if (childPtr->histogram != NULL)
+            memset (childPtr->histogram, 0,
+                    PROF_HIST_SIZE * sizeof (unsigned int));
+        ResetProfNodes (childPtr);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * TakeSnapshot --
+ *   Dump the data collected so far to an array variable or a list, without
+ * stopping profiling.
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o infoPtr - The global profiling info.
+ *   o reset - If TRUE, the data is cleared, so the next snapshot only has
+ *     the data collected after this one.
+ *   o varName - The name of the array variable to save the data in, or NULL.
+ *   o listPtr - If varName is NULL, the list to append the data to.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+TakeSnapshot (interp, infoPtr, reset, varName, listPtr)
+    Tcl_Interp *interp;
+    profInfo_t *infoPtr;
+    int         reset;
+    char       *varName;
+    Tcl_Obj    *listPtr;
+{
+    if (infoPtr->sampleUsec == 0)
+        FlushEntryTimes (infoPtr);
+
+    ExportProfNodes (infoPtr, &infoPtr->rootNode);
+    if (reset)
+        ResetProfNodes (&infoPtr->rootNode);
+
+    if (varName != NULL)
+        Tcl_UnsetVar (interp, varName, 0);
+    return DumpDataTable (interp, infoPtr, varName, listPtr);
+}
+
+/*-----------------------------------------------------------------------------
+ * AutoDumpProc --
+ *   Timer handler that appends a snapshot to the auto-dump file and
+ * reschedules itself.  Each snapshot is written as a line containing a list
+ * of the time in milliseconds and the data, in the form returned by array
+ * get.  If the file can't be written, auto-dumping stops and a background
+ * error is reported.
+ *
+ * Parameters:
+ *   o clientData - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+AutoDumpProc (clientData)
+    ClientData clientData;
+{
+    profInfo_t *infoPtr = (profInfo_t *) clientData;
+    Tcl_Interp *interp = infoPtr->interp;
+    Tcl_Obj *recordPtr, *dataPtr;
+    Tcl_Channel channel;
+    Tcl_SavedResult savedResult;
+    Tcl_Time now;
+    int result;
+
+    infoPtr->dumpTimer = NULL;
+
+    Tcl_Preserve ((ClientData) interp);
+    Tcl_SaveResult (interp, &savedResult);
+
+    Tcl_GetTime (&now);
+    recordPtr = Tcl_NewListObj (0, NULL);
+    Tcl_IncrRefCount (recordPtr);
+    Tcl_ListObjAppendElement (NULL, recordPtr,
+                              Tcl_NewWideIntObj ((Tcl_WideInt) now.sec * 1000 +
+                                                 now.usec / 1000));
+    dataPtr = Tcl_NewListObj (0, NULL);
+    Tcl_ListObjAppendElement (NULL, recordPtr, dataPtr);
+
+    result = TakeSnapshot (interp, infoPtr, infoPtr->dumpReset, NULL,
+                           dataPtr);
+    if (result == TCL_OK) {
+        channel = Tcl_OpenFileChannel (interp, infoPtr->dumpFile, "a", 0666);
+        if (channel == NULL) {
+            result = TCL_ERROR;
+        } else {
+            Tcl_SetChannelOption (NULL, channel, "-encoding", "utf-8");
+            if ((Tcl_WriteObj (channel, recordPtr) < 0) ||
+                (Tcl_WriteChars (channel, "\n", 1) < 0)) {
+                TclX_AppendObjResult (interp, "error writing \"",
+                                      infoPtr->dumpFile, "\": ",
+                                      Tcl_PosixError (interp), (char *) NULL);
+                Tcl_Close (NULL, channel);
+                result = TCL_ERROR;
+            } else {
+                result = Tcl_Close (interp, channel);
+            }
+        }
+    }
+    Tcl_DecrRefCount (recordPtr);
+
+    if (result == TCL_OK) {
+        infoPtr->dumpTimer = Tcl_CreateTimerHandler (infoPtr->dumpInterval,
+                                                     AutoDumpProc,
+                                                     clientData);
+        Tcl_RestoreResult (interp, &savedResult);
+    } else {
+        Tcl_DiscardResult (&savedResult);
+        StopAutoDump (infoPtr);
+        Tcl_AddErrorInfo (interp, "\n    (profile auto-dump)");
+        Tcl_BackgroundError (interp);
+    }
+    Tcl_Release ((ClientData) interp);
+}
+
+/*-----------------------------------------------------------------------------
+ * StopAutoDump --
+ *   Stop auto-dumping snapshots, if it is active.
+ *
+ * Parameters:
+ *   o infoPtr - The global profiling info.
+ *-----------------------------------------------------------------------------
+ */
+static void
+StopAutoDump (infoPtr)
+    profInfo_t *infoPtr;
+{
+    if (infoPtr->dumpTimer != NULL) {
+        Tcl_DeleteTimerHandler (infoPtr->dumpTimer);
+        infoPtr->dumpTimer = NULL;
+    }
+    if (infoPtr->dumpFile != NULL) {
+        ckfree (infoPtr->dumpFile);
+        infoPtr->dumpFile = NULL;
+    }
+    infoPtr->dumpInterval = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * ProfileSnapshotCmd --
+ *   Implements the profile snapshot command:
+ *     profile snapshot ?-reset? arrayVar
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o infoPtr - The global profiling info.
+ *   o objc, objv - The arguments following snapshot.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+ProfileSnapshotCmd (interp, infoPtr, objc, objv)
+    Tcl_Interp *interp;
+    profInfo_t *infoPtr;
+    int         objc;
+    Tcl_Obj   *CONST objv[];
+{
+    int reset = FALSE;
+
+    if ((objc == 2) &&
+        STREQU (Tcl_GetStringFromObj (objv [0], NULL), "-reset")) {
+        reset = TRUE;
+        objc--;
+        objv++;
+    }
+    if (objc != 1) {
+        TclX_AppendObjResult (interp, tclXWrongArgs, "profile snapshot ",
+                              "?-reset? arrayVar", (char *) NULL);
+        return TCL_ERROR;
+    }
+    return TakeSnapshot (interp, infoPtr, reset,
+                         Tcl_GetStringFromObj (objv [0], NULL), NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ * ProfileAutoDumpCmd --
+ *   Implements the profile autodump command:
+ *     profile autodump ?-reset? milliseconds fileName
+ *     profile autodump off
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o infoPtr - The global profiling info.
+ *   o objc, objv - The arguments following autodump.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+ProfileAutoDumpCmd (interp, infoPtr, objc, objv)
+    Tcl_Interp *interp;
+    profInfo_t *infoPtr;
+    int         objc;
+    Tcl_Obj   *CONST objv[];
+{
+    int reset = FALSE, interval;
+
+    if ((objc == 1) &&
+        STREQU (Tcl_GetStringFromObj (objv [0], NULL), "off")) {
+        StopAutoDump (infoPtr);
+        return TCL_OK;
+    }
+    if ((objc == 3) &&
+        STREQU (Tcl_GetStringFromObj (objv [0], NULL), "-reset")) {
+        reset = TRUE;
+        objc--;
+        objv++;
+    }
+    if (objc != 2) {
+        TclX_AppendObjResult (interp, tclXWrongArgs, "profile autodump ",
+                              "?-reset? milliseconds fileName",
+                              (char *) NULL);
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj (interp, objv [0], &interval) != TCL_OK)
+        return TCL_ERROR;
+    if (interval <= 0) {
+        TclX_AppendObjResult (interp, "auto-dump interval must be greater ",
+                              "than zero, got \"",
+                              Tcl_GetStringFromObj (objv [0], NULL), "\"",
+                              (char *) NULL);
+        return TCL_ERROR;
+    }
+
+    StopAutoDump (infoPtr);
+    infoPtr->dumpInterval = interval;
+    infoPtr->dumpReset = reset;
+    infoPtr->dumpFile = ckstrdup (Tcl_GetStringFromObj (objv [1], NULL));
+    infoPtr->dumpTimer = Tcl_CreateTimerHandler (interval, AutoDumpProc,
+                                                 (ClientData) infoPtr);
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * GetProfArray --
+ *   Get the contents of a profile data array, as returned by array get.
+ *
+ * Parameters:
+ *   o interp - Errors are returned in result.
+ *   o varNameObj - The name of the array.
+ *   o elemcPtr, elemvPtr - The alternating stack lists and data are returned
+ *     here.  They are valid until the returned object is released.
+ * Returns:
+ *   The list, with a reference that the caller must release, or NULL on an
+ *   error.
+ *-----------------------------------------------------------------------------
+ */
+static Tcl_Obj *
+GetProfArray (interp, varNameObj, elemcPtr, elemvPtr)
+    Tcl_Interp *interp;
+    Tcl_Obj    *varNameObj;
+    int        *elemcPtr;
+    Tcl_Obj  ***elemvPtr;
+{
+    Tcl_Obj *cmdObjv [3], *listObj;
+    int result;
+
+    cmdObjv [0] = Tcl_NewStringObj ("array", -1);
+    cmdObjv [1] = Tcl_NewStringObj ("get", -1);
+    cmdObjv [2] = varNameObj;
+    Tcl_IncrRefCount (cmdObjv [0]);
+    Tcl_IncrRefCount (cmdObjv [1]);
+    result = Tcl_EvalObjv (interp, 3, cmdObjv, 0);
+    Tcl_DecrRefCount (cmdObjv [0]);
+    Tcl_DecrRefCount (cmdObjv [1]);
+    if (result != TCL_OK)
+        return NULL;
+
+    listObj = Tcl_GetObjResult (interp);
+    Tcl_IncrRefCount (listObj);
+    Tcl_ResetResult (interp);
+    if (Tcl_ListObjGetElements (interp, listObj, elemcPtr,
+                                elemvPtr) != TCL_OK) {
+        Tcl_DecrRefCount (listObj);
+        return NULL;
+    }
+    return listObj;
+}
+
+/*-----------------------------------------------------------------------------
+ * GetProfArrayData --
+ *   Get the count, real and CPU time and the heap growth and shrinkage from a
+ * profile data array entry.  The entry has heap values if its length is that
+ * of the data collected with -memory, with or without -latency.
+ *
+ * Parameters:
+ *   o interp - Errors are returned in result.
+ *   o dataObj - The entry, a list starting with the three values.
+ *   o dataPtr - An array of five values to return them in.  The heap values
+ *     are zero if the entry doesn't have them.
+ *   o hasMemoryPtr - TRUE is returned here if the entry has heap values.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+GetProfArrayData (interp, dataObj, dataPtr, hasMemoryPtr)
+    Tcl_Interp  *interp;
+    Tcl_Obj     *dataObj;
+    Tcl_WideInt *dataPtr;
+    int         *hasMemoryPtr;
+{
+    Tcl_Obj **dataObjv;
+    int dataObjc, idx;
+
+    if (Tcl_ListObjGetElements (interp, dataObj, &dataObjc,
+                                &dataObjv) != TCL_OK)
+        return TCL_ERROR;
+    if (dataObjc < 3) {
+        TclX_AppendObjResult (interp, "invalid profile data \"",
+                              Tcl_GetStringFromObj (dataObj, NULL),
+                              "\", expected count, real and CPU time",
+                              (char *) NULL);
+        return TCL_ERROR;
+    }
+    for (idx = 0; idx < 3; idx++) {
+        if (Tcl_GetWideIntFromObj (interp, dataObjv [idx],
+                                   &dataPtr [idx]) != TCL_OK)
+            return TCL_ERROR;
+    }
+
+    *hasMemoryPtr =
+        (dataObjc == PROF_DATA_BASIC + PROF_DATA_MEMORY) ||
+        (dataObjc == PROF_DATA_BASIC + PROF_DATA_LATENCY + PROF_DATA_MEMORY);
+    dataPtr [3] = 0;
+    dataPtr [4] = 0;
+    if (*hasMemoryPtr) {
+        for (idx = 0; idx < 2; idx++) {
+            if (Tcl_GetWideIntFromObj (interp,
+                                       dataObjv [dataObjc - 2 + idx],
+                                       &dataPtr [3 + idx]) != TCL_OK)
+                return TCL_ERROR;
+        }
+    }
+    return TCL_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * ProfileSumCmd --
+ *   Implements the profile sum command:
+ *     profile sum inArrayVar outArrayVar
+ *
+ * Converts profile data from the time spent in each procedure to the time
+ * spent in it and everything it called, by adding the times of each stack to
+ * every stack that is a suffix of it.  The heap growth and shrinkage are
+ * summed the same way, and are included in the result if any entry has them.
+ * The calls are only added to the stack itself.
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o objc, objv - The arguments following sum.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+ProfileSumCmd (interp, objc, objv)
+    Tcl_Interp *interp;
+    int         objc;
+    Tcl_Obj   *CONST objv[];
+{
+    Tcl_Obj *arrayObj, **arrayObjv, **stackObjv;
+    Tcl_Obj *dataObjv [PROF_DATA_BASIC + PROF_DATA_MEMORY];
+    int arrayObjc, stackObjc, idx, part, newEntry, argvSize = 0;
+    int hasMemory, anyMemory = FALSE;
+    Tcl_WideInt data [PROF_DATA_BASIC + PROF_DATA_MEMORY];
+    CONST84 char **stackArgv = NULL;
+    char *stackListPtr, *outVarName;
+    Tcl_HashTable sumTable;
+    Tcl_HashEntry *hashEntryPtr;
+    Tcl_HashSearch searchCookie;
+    profDataEntry_t *sumEntryPtr;
+    int result = TCL_ERROR;
+
+    if (objc != 2) {
+        TclX_AppendObjResult (interp, tclXWrongArgs, "profile sum ",
+                              "inArrayVar outArrayVar", (char *) NULL);
+        return TCL_ERROR;
+    }
+    arrayObj = GetProfArray (interp, objv [0], &arrayObjc, &arrayObjv);
+    if (arrayObj == NULL)
+        return TCL_ERROR;
+
+    Tcl_InitHashTable (&sumTable, TCL_STRING_KEYS);
+
+    for (idx = 0; idx < arrayObjc; idx += 2) {
+        if ((Tcl_ListObjGetElements (interp, arrayObjv [idx], &stackObjc,
+                                     &stackObjv) != TCL_OK) ||
+            (GetProfArrayData (interp, arrayObjv [idx + 1], data,
+                               &hasMemory) != TCL_OK))
+            goto exitPoint;
+        anyMemory |= hasMemory;
+
+        if (stackObjc > argvSize) {
+            argvSize = stackObjc * 2;
+            stackArgv = (CONST84 char **)
+                ckrealloc ((char *) stackArgv, argvSize * sizeof (char *));
+        }
+        for (part = 0; part < stackObjc; part++) {
+            stackArgv [part] = Tcl_GetStringFromObj (stackObjv [part], NULL);
+        }
+
+        /*
+         * Add to the stack and each stack it is called from.
+         */
+        for (part = 0; part < stackObjc; part++) {
+            stackListPtr = Tcl_Merge (stackObjc - part, stackArgv + part);
+            hashEntryPtr = Tcl_CreateHashEntry (&sumTable, stackListPtr,
+                                                &newEntry);
+            ckfree (stackListPtr);
+            if (newEntry) {
+                sumEntryPtr = (profDataEntry_t *)
+                    ckalloc (sizeof (profDataEntry_t));
+                sumEntryPtr->count = 0;
+                sumEntryPtr->realTime = 0;
+                sumEntryPtr->cpuTime = 0;
+                sumEntryPtr->histogram = NULL;
+                sumEntryPtr->maxTime = 0;
+                sumEntryPtr->allocBytes = 0;
+                sumEntryPtr->freeBytes = 0;
+                Tcl_SetHashValue (hashEntryPtr, sumEntryPtr);
+            } else {
+                sumEntryPtr = (profDataEntry_t *)
+                    Tcl_GetHashValue (hashEntryPtr);
+            }
+            if (part == 0)
+                sumEntryPtr->count += data [0];
+            sumEntryPtr->realTime += data [1];
+            sumEntryPtr->cpuTime += data [2];
+            sumEntryPtr->allocBytes += data [3];
+            sumEntryPtr->freeBytes += data [4];
+        }
+    }
+
+    outVarName = Tcl_GetStringFromObj (objv [1], NULL);
+    hashEntryPtr = Tcl_FirstHashEntry (&sumTable, &searchCookie);
+    while (hashEntryPtr != NULL) {
+        sumEntryPtr = (profDataEntry_t *) Tcl_GetHashValue (hashEntryPtr);
+        dataObjv [0] = Tcl_NewWideIntObj (sumEntryPtr->count);
+        dataObjv [1] = Tcl_NewWideIntObj (sumEntryPtr->realTime);
+        dataObjv [2] = Tcl_NewWideIntObj (sumEntryPtr->cpuTime);
+        dataObjv [3] = Tcl_NewWideIntObj (sumEntryPtr->allocBytes);
+        dataObjv [4] = Tcl_NewWideIntObj (sumEntryPtr->freeBytes);
+        if (Tcl_SetVar2Ex (interp, outVarName,
+                           Tcl_GetHashKey (&sumTable, hashEntryPtr),
+                           Tcl_NewListObj (anyMemory ? 5 : 3, dataObjv),
+                           TCL_LEAVE_ERR_MSG) == NULL)
+            goto exitPoint;
+        hashEntryPtr = Tcl_NextHashEntry (&searchCookie);
+    }
+    result = TCL_OK;
+
+  exitPoint:
+    hashEntryPtr = Tcl_FirstHashEntry (&sumTable, &searchCookie);
+    while (hashEntryPtr != NULL) {
+        ckfree ((char *) Tcl_GetHashValue (hashEntryPtr));
+        hashEntryPtr = Tcl_NextHashEntry (&searchCookie);
+    }
+    Tcl_DeleteHashTable (&sumTable);
+    if (stackArgv != NULL)
+        ckfree ((char *) stackArgv);
+    Tcl_DecrRefCount (arrayObj);
+    return result;
+}
+
+/*-----------------------------------------------------------------------------
+ * ProfSortCompare --
+ *   qsort comparison function for profile sort.  Sorts in descending order
+ * of value, then by stack list so the order does not depend on the order of
+ * the array.
+ *-----------------------------------------------------------------------------
+ */
+static int
+ProfSortCompare (left, right)
+    CONST VOID *left;
+    CONST VOID *right;
+{
+    profSortEntry_t *leftPtr = (profSortEntry_t *) left;
+    profSortEntry_t *rightPtr = (profSortEntry_t *) right;
+
+    if (leftPtr->value > rightPtr->value)
+        return -1;
+    if (leftPtr->value < rightPtr->value)
+        return 1;
+    return strcmp (Tcl_GetStringFromObj (leftPtr->stackObj, NULL),
+                   Tcl_GetStringFromObj (rightPtr->stackObj, NULL));
+}
+
+/*-----------------------------------------------------------------------------
+ * ProfileSortCmd --
+ *   Implements the profile sort command:
+ *     profile sort arrayVar calls|real|cpu|alloc|free
+ *
+ * Returns the stack lists of the profile data array, sorted in descending
+ * order by the specified value.  Entries without heap values are sorted as
+ * if they were zero.
+ *
+ * Parameters:
+ *   o interp - Pointer to the interprer.
+ *   o objc, objv - The arguments following sort.
+ * Returns:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+static int
+ProfileSortCmd (interp, objc, objv)
+    Tcl_Interp *interp;
+    int         objc;
+    Tcl_Obj   *CONST objv[];
+{
+    static CONST84 char *sortKeys [] = {
+        "calls", "real", "cpu", "alloc", "free", NULL};
+    Tcl_Obj *arrayObj, **arrayObjv, *resultObj;
+    int arrayObjc, keyIndex, numEntries, idx, hasMemory;
+    Tcl_WideInt data [PROF_DATA_BASIC + PROF_DATA_MEMORY];
+    profSortEntry_t *sortEntries;
+
+    if (objc != 2) {
+        TclX_AppendObjResult (interp, tclXWrongArgs, "profile sort ",
+                              "arrayVar calls|real|cpu|alloc|free",
+                              (char *) NULL);
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj (interp, objv [1], sortKeys, "sort key",
+                             TCL_EXACT, &keyIndex) != TCL_OK)
+        return TCL_ERROR;
+
+    arrayObj = GetProfArray (interp, objv [0], &arrayObjc, &arrayObjv);
+    if (arrayObj == NULL)
+        return TCL_ERROR;
+
+    numEntries = arrayObjc / 2;
+    sortEntries = (profSortEntry_t *)
+        ckalloc ((numEntries + 1) * sizeof (profSortEntry_t));
+    for (idx = 0; idx < numEntries; idx++) {
+        if (GetProfArrayData (interp, arrayObjv [idx * 2 + 1],
+                              data, &hasMemory) != TCL_OK) {
+            ckfree ((char *) sortEntries);
+            Tcl_DecrRefCount (arrayObj);
+            return TCL_ERROR;
+        }
+        sortEntries [idx].stackObj = arrayObjv [idx * 2];
+        sortEntries [idx].value = data [keyIndex];
+    }
+    qsort ((VOID *) sortEntries, (size_t) numEntries, sizeof (profSortEntry_t),
+           ProfSortCompare);
+
+    resultObj = Tcl_NewListObj (0, NULL);
+    for (idx = 0; idx < numEntries; idx++) {
+        Tcl_ListObjAppendElement (NULL, resultObj, sortEntries [idx].stackObj);
+    }
+    Tcl_SetObjResult (interp, resultObj);
+
+    ckfree ((char *) sortEntries);
+    Tcl_DecrRefCount (arrayObj);
+    return TCL_OK;
+}
+
 /*-----------------------------------------------------------------------------
  * TclX_ProfileObjCmd --
  *   Implements the TCL profile command:
- *     profile ?-commands? ?-eval? on
- *     profile off arrayvar
+ *     profile ?-commands? ?-eval? ?-latency? ?-memory? ?-sample usec? on
+ *     profile ?-folded file? ?-pprof file? off ?arrayvar?
+ *     profile snapshot ?-reset? arrayVar
+ *     profile autodump ?-reset? milliseconds fileName|off
+ *     profile sum inArrayVar outArrayVar
+ *     profile sort arrayVar calls|real|cpu|alloc|free
  *-----------------------------------------------------------------------------
  */
 static int
@@ -825,8 +2792,11 @@ TclX_ProfileObjCmd (clientData, interp, objc, objv)
 {
     profInfo_t *infoPtr = (profInfo_t *) clientData;
     int argIdx;
-    int commandMode = FALSE, evalMode = FALSE;
-    char *argStr;
+    int commandMode = FALSE, evalMode = FALSE, latencyMode = FALSE;
+    int memoryMode = FALSE;
+    long sampleUsec = 0;
+    char *argStr, *varName, *foldedFile = NULL, *pprofFile = NULL;
+    Tcl_Channel foldedChan = NULL, pprofChan = NULL;
         
     /*
      * Parse option arguments.
@@ -839,9 +2809,37 @@ TclX_ProfileObjCmd (clientData, interp, objc, objv)
             commandMode = TRUE;
         } else if (STREQU (argStr, "-eval")) {
             evalMode = TRUE;
+        } else if (STREQU (argStr, "-latency")) {
+            latencyMode = TRUE;
+        } else if (STREQU (argStr, "-memory")) {
+            memoryMode = TRUE;
+        } else if (STREQU (argStr, "-sample")) {
+            if (++argIdx >= objc)
+                goto wrongArgs;
+            if (Tcl_GetLongFromObj (interp, objv [argIdx],
+                                    &sampleUsec) != TCL_OK)
+                return TCL_ERROR;
+            if (sampleUsec <= 0) {
+                TclX_AppendObjResult (interp, "sample interval must be ",
+                                      "greater than zero, got \"",
+                                      Tcl_GetStringFromObj (objv [argIdx],
+                                                            NULL),
+                                      "\"", (char *) NULL);
+                return TCL_ERROR;
+            }
+        } else if (STREQU (argStr, "-folded")) {
+            if (++argIdx >= objc)
+                goto wrongArgs;
+            foldedFile = Tcl_GetStringFromObj (objv [argIdx], NULL);
+        } else if (STREQU (argStr, "-pprof")) {
+            if (++argIdx >= objc)
+                goto wrongArgs;
+            pprofFile = Tcl_GetStringFromObj (objv [argIdx], NULL);
         } else {
-            TclX_AppendObjResult (interp, "expected one of \"-commands\", or ",
-                                  "\"-eval\", got \"", argStr, "\"",
+            TclX_AppendObjResult (interp, "expected one of \"-commands\", ",
+                                  "\"-eval\", \"-latency\", \"-memory\", ",
+                                  "\"-sample\", \"-folded\", or ",
+                                  "\"-pprof\", got \"", argStr, "\"",
                                   (char *) NULL);
             return TCL_ERROR;
         }
@@ -861,55 +2859,157 @@ TclX_ProfileObjCmd (clientData, interp, objc, objv)
         if (argIdx != objc - 1)
             goto wrongArgs;
 
-        if (infoPtr->traceHandle != NULL) {
+        if ((foldedFile != NULL) || (pprofFile != NULL)) {
+            TclX_AppendObjResult (interp, "option \"",
+                                  (foldedFile != NULL) ? "-folded" : "-pprof",
+                                  "\" not valid when turning on profiling",
+                                  (char *) NULL);
+            return TCL_ERROR;
+        }
+
+        if ((infoPtr->traceHandle != NULL) || (infoPtr->sampleUsec != 0)) {
             TclX_AppendObjResult (interp, "profiling is already enabled",
                                   (char *) NULL);
             return TCL_ERROR; 
         }
 
-        TurnOnProfiling (infoPtr, commandMode, evalMode);
+        if (sampleUsec != 0) {
+            if (commandMode || latencyMode || memoryMode) {
+                TclX_AppendObjResult (interp, "option \"",
+                                      commandMode ? "-commands" :
+                                      (latencyMode ? "-latency" : "-memory"),
+                                      "\" not valid with \"-sample\"",
+                                      (char *) NULL);
+                return TCL_ERROR;
+            }
+            return TurnOnSampling (interp, infoPtr, sampleUsec, evalMode);
+        }
+
+        if (memoryMode) {
+            Tcl_WideInt heapSize;
+
+            if (TclXOSheapsize (interp, &heapSize, "profile -memory")
+                != TCL_OK)
+                return TCL_ERROR;
+        }
+
+        TurnOnProfiling (infoPtr, commandMode, evalMode, latencyMode,
+                         memoryMode);
         return TCL_OK;
     }
 
     /*
-     * Handle the off command.  Dump the hash table to a variable.
+     * Handle the off command.  Export the data to files and dump the hash
+     * table to a variable.  The variable is optional if exporting.
      */
     if (STREQU (argStr, "off")) {
 
-        if (argIdx != objc - 2)
+        if (argIdx == objc - 2) {
+            varName = Tcl_GetStringFromObj (objv [argIdx + 1], NULL);
+        } else if ((argIdx == objc - 1) &&
+                   ((foldedFile != NULL) || (pprofFile != NULL))) {
+            varName = NULL;
+        } else {
             goto wrongArgs;
+        }
 
-        if (commandMode || evalMode) {
+        if (commandMode || evalMode || latencyMode || memoryMode ||
+            (sampleUsec != 0)) {
             TclX_AppendObjResult (interp, "option \"",
-                                  commandMode ? "-command" : "-eval",
+                                  commandMode ? "-command" :
+                                  (evalMode ? "-eval" :
+                                   (latencyMode ? "-latency" :
+                                    (memoryMode ? "-memory" : "-sample"))),
                                   "\" not valid when turning off ",
                                   "profiling", (char *) NULL);
             return TCL_ERROR;
         }
 
-        if (infoPtr->traceHandle == NULL) {
+        if ((infoPtr->traceHandle == NULL) && (infoPtr->sampleUsec == 0)) {
             TclX_AppendObjResult (interp, "profiling is not currently enabled",
                                   (char *) NULL);
             return TCL_ERROR;
         }
-            
-        if (TurnOffProfiling (interp, infoPtr, 
-                              Tcl_GetStringFromObj (objv [argIdx + 1],
-                                                    NULL)) != TCL_OK)
+
+        /*
+         * Open the export files before stopping, so the data is not lost if
+         * they can't be created.
+         */
+        if (foldedFile != NULL) {
+            foldedChan = Tcl_OpenFileChannel (interp, foldedFile, "w", 0666);
+            if ((foldedChan == NULL) ||
+                (Tcl_SetChannelOption (interp, foldedChan, "-encoding",
+                                       "utf-8") != TCL_OK))
+                goto errorExit;
+        }
+        if (pprofFile != NULL) {
+            pprofChan = Tcl_OpenFileChannel (interp, pprofFile, "w", 0666);
+            if ((pprofChan == NULL) ||
+                (Tcl_SetChannelOption (interp, pprofChan, "-translation",
+                                       "binary") != TCL_OK))
+                goto errorExit;
+        }
+
+        if (TurnOffProfiling (interp, infoPtr, varName, foldedChan,
+                              pprofChan) != TCL_OK)
             return TCL_ERROR;
         return TCL_OK;
     }
 
+    /*
+     * Handle the snapshot and autodump commands, which take their options
+     * after the command.
+     */
+    if (STREQU (argStr, "snapshot") || STREQU (argStr, "autodump")) {
+        if (argIdx != 1) {
+            TclX_AppendObjResult (interp, "options must follow \"", argStr,
+                                  "\"", (char *) NULL);
+            return TCL_ERROR;
+        }
+        if ((infoPtr->traceHandle == NULL) && (infoPtr->sampleUsec == 0)) {
+            TclX_AppendObjResult (interp, "profiling is not currently enabled",
+                                  (char *) NULL);
+            return TCL_ERROR;
+        }
+        if (STREQU (argStr, "snapshot"))
+            return ProfileSnapshotCmd (interp, infoPtr, objc - 2, objv + 2);
+        return ProfileAutoDumpCmd (interp, infoPtr, objc - 2, objv + 2);
+    }
+
+    /*
+     * Handle the report commands, which only work on the data in arrays.
+     */
+    if (STREQU (argStr, "sum") || STREQU (argStr, "sort")) {
+        if (argIdx != 1) {
+            TclX_AppendObjResult (interp, "options must follow \"", argStr,
+                                  "\"", (char *) NULL);
+            return TCL_ERROR;
+        }
+        if (STREQU (argStr, "sum"))
+            return ProfileSumCmd (interp, objc - 2, objv + 2);
+        return ProfileSortCmd (interp, objc - 2, objv + 2);
+    }
+
     /*
      * Not a valid subcommand.
      */
-    TclX_AppendObjResult (interp, "expected one of \"on\" or \"off\", got \"",
-                          argStr, "\"", (char *) NULL);
+    TclX_AppendObjResult (interp, "expected one of \"on\", \"off\", ",
+                          "\"snapshot\", \"autodump\", \"sum\", or ",
+                          "\"sort\", got \"", argStr, "\"", (char *) NULL);
     return TCL_ERROR;
 
   wrongArgs:
     return TclX_WrongArgs (interp, objv [0],
-                           "?-commands? ?-eval? on|off arrayVar");
+                           "?-commands? ?-eval? ?-latency? ?-memory? "
+                           "?-sample usec? ?-folded file? ?-pprof file? "
+                           "on|off ?arrayVar?");
+
+  errorExit:
+    if (foldedChan != NULL)
+        Tcl_Close (NULL, foldedChan);
+    if (pprofChan != NULL)
+        Tcl_Close (NULL, pprofChan);
+    return TCL_ERROR;
 }
 
 /*-----------------------------------------------------------------------------
@@ -926,7 +3026,12 @@ ProfMonCleanUp (clientData, interp)
 
     if (infoPtr->traceHandle != NULL)
         DeleteProfTrace (infoPtr);
-    CleanDataTable (infoPtr);
+    if (infoPtr->sampleUsec != 0)
+        TurnOffSampling (infoPtr);
+    if (infoPtr->sampleHandler != NULL)
+        Tcl_AsyncDelete (infoPtr->sampleHandler);
+    StopAutoDump (infoPtr);
+    CleanProfData (infoPtr);
     Tcl_DeleteHashTable (&infoPtr->profDataTable);
     ckfree ((char *) infoPtr);
 }
@@ -948,6 +3053,10 @@ TclX_ProfileInit (interp)
     infoPtr->traceHandle = NULL;
     infoPtr->commandMode = FALSE;
     infoPtr->evalMode = FALSE;
+    infoPtr->latencyMode = FALSE;
+    infoPtr->memoryMode = FALSE;
+    infoPtr->sampleUsec = 0;
+    infoPtr->sampleHandler = NULL;
     infoPtr->currentCmd = NULL;
     infoPtr->evalLevel = UNKNOWN_LEVEL;
     infoPtr->realTime = 0;
@@ -955,9 +3064,27 @@ TclX_ProfileInit (interp)
     infoPtr->prevRealTime = 0;
     infoPtr->prevCpuTime = 0;
     infoPtr->updatedTimes = FALSE;
+    infoPtr->heapSize = 0;
+    infoPtr->prevHeapSize = 0;
+    infoPtr->allocatedHeap = FALSE;
     infoPtr->stackPtr = NULL;
     infoPtr->stackSize = 0;
     infoPtr->scopeChainPtr = NULL;
+    infoPtr->freeEntryPtr = NULL;
+    infoPtr->dumpTimer = NULL;
+    infoPtr->dumpInterval = 0;
+    infoPtr->dumpReset = FALSE;
+    infoPtr->dumpFile = NULL;
+    infoPtr->rootNode.cmd = NULL;
+    infoPtr->rootNode.cmdName = NULL;
+    infoPtr->rootNode.count = 0;
+    infoPtr->rootNode.realTime = 0;
+    infoPtr->rootNode.cpuTime = 0;
+    infoPtr->rootNode.parentPtr = NULL;
+    infoPtr->rootNode.childPtr = NULL;
+    infoPtr->rootNode.siblingPtr = NULL;
+    infoPtr->rootNode.histogram = NULL;
+    infoPtr->rootNode.maxTime = 0;
     Tcl_InitHashTable (&infoPtr->profDataTable, TCL_STRING_KEYS);
 
     Tcl_CallWhenDeleted (interp, ProfMonCleanUp, (ClientData) infoPtr);
@@ -27,40 +27,7 @@ namespace eval TclXProfRep {
     proc sum {inDataVar outDataVar} {
         upvar 1 $inDataVar inData $outDataVar outData
 
-        foreach inStack [array names inData] {
-            for {set idx 0} {![lempty [set part [lrange $inStack $idx end]]]} \
-                    {incr idx} {
-                if ![info exists outData($part)] {
-                    set outData($part) {0 0 0}
-                }
-                lassign $outData($part) count real cpu
-                if {$idx == 0} {
-                    incr count [lindex $inData($inStack) 0]
-                }
-                incr real [lindex $inData($inStack) 1]
-                incr cpu [lindex $inData($inStack) 2]
-                set outData($part) [list $count $real $cpu]
-            }
-        }
-    }
-
-    #
-    # Do sort comparison.  May only be called by sort, as it address its
-    # local variables.
-    #
-    proc sortcmp {key1 key2} {
-        upvar profData profData keyIndex keyIndex
-
-        set val1 [lindex $profData($key1) $keyIndex]
-        set val2 [lindex $profData($key2) $keyIndex]
-
-        if {$val1 < $val2} {
-            return -1
-        }
-        if {$val1 > $val2} {
-            return 1
-        }
-        return 0
+        profile sum inData outData
     }
 
     #
@@ -70,21 +37,17 @@ namespace eval TclXProfRep {
     proc sort {profDataVar sortKey} {
         upvar $profDataVar profData
 
-        case $sortKey {
-            {calls} {set keyIndex 0}
-            {real}  {set keyIndex 1}
-            {cpu}   {set keyIndex 2}
-            default {
-                error "Expected a sort type of: `calls', `cpu' or ` real'"
-            }
+        if {[lsearch -exact {calls real cpu alloc free} $sortKey] < 0} {
+            error "Expected a sort type of: `calls', `cpu', `real',\
+                    `alloc' or `free'"
         }
-
-        return [lsort -integer -decreasing -command sortcmp \
-                [array names profData]]
+        return [profile sort profData $sortKey]
     }
 
     #
-    # Print the sorted report
+    # Print the sorted report.  The profile data is in nanoseconds, the times
+    # are reported in microseconds.  If the data was collected with -memory,
+    # the heap growth and shrinkage in bytes follow the times.
     #
     proc print {profDataVar sortedProcList outFile userTitle} {
         upvar $profDataVar profData
@@ -104,10 +67,21 @@ namespace eval TclXProfRep {
 
         # Output a header.
 
+        set memory 0
+        foreach procStack $sortedProcList {
+            if {[llength $profData($procStack)] == 5} {
+                set memory 1
+                break
+            }
+        }
+
         set stackTitle "Procedure Call Stack"
         set maxNameLen [max [expr $maxNameLen+6] [expr [clength $stackTitle]+4]]
         set hdr [format "%-${maxNameLen}s %10s %10s %10s" $stackTitle \
-                        "Calls" "Real Time" "CPU Time"]
+                        "Calls" "Real usec" "CPU usec"]
+        if {$memory} {
+            append hdr [format " %12s %12s" "Alloc bytes" "Free bytes"]
+        }
         if {$userTitle != ""} {
             puts $outFH [replicate - [clength $hdr]]
             puts $outFH $userTitle
@@ -122,9 +96,15 @@ namespace eval TclXProfRep {
             set data $profData($procStack)
             set cmd [lvarpop procStack]
             regsub {^::} $cmd {} cmd
-            puts $outFH [format "%-${maxNameLen}s %10d %10d %10d" \
-                                $cmd [lindex $data 0] [lindex $data 1] \
-                                [lindex $data 2]]
+            set line [format "%-${maxNameLen}s %10ld %10ld %10ld" \
+                             $cmd [lindex $data 0] \
+                             [expr {[lindex $data 1] / 1000}] \
+                             [expr {[lindex $data 2] / 1000}]]
+            if {$memory} {
+                append line [format " %12ld %12ld" [lindex $data 3] \
+                                    [lindex $data 4]]
+            }
+            puts $outFH $line
             foreach procName $procStack {
                 if {$procName == "<global>"} break
                 regsub {^::} $procName {} procName
@@ -141,7 +121,8 @@ namespace eval TclXProfRep {
 #------------------------------------------------------------------------------
 # Generate a report from data collect from the profile command.
 #   o profDataVar (I) - The name of the array containing the data from profile.
-#   o sortKey (I) - Value to sort by. One of "calls", "cpu" or "real".
+#   o sortKey (I) - Value to sort by. One of "calls", "cpu" or "real", or
+#     "alloc" or "free" if the data was collected with -memory.
 #   o outFile (I) - Name of file to write the report to.  If omitted, stdout
 #     is assumed.
 #   o userTitle (I) - Title line to add to output.
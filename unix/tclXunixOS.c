@@ -27,6 +27,12 @@
 #include <sys/resource.h>
 #endif
 
+#if defined(__GLIBC__) && !defined(NO_MALLINFO)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
 /*
  * Tcl 8.4 had some weird and unnecessary ifdef'ery for readdir
  * readdir() should be thread-safe according to the Single Unix Spec.
@@ -315,6 +321,134 @@ TclXOSsetitimer (interp, seconds, funcName)
 #endif
 }
 
+#if !defined(NO_SETITIMER) && defined(ITIMER_PROF) && defined(SIGPROF)
+/*
+ * Function called on each tick of the profiling timer and the signal action
+ * it replaced.
+ */
+static TclXOSTimerProc *profTimerProc = NULL;
+#ifndef NO_SIGACTION
+static struct sigaction profOldAction;
+#else
+static void (*profOldAction) _ANSI_ARGS_((int signalNum));
+#endif
+
+/*-----------------------------------------------------------------------------
+ * ProfTimerSignal --
+ *   SIGPROF handler for the profiling timer.
+ *-----------------------------------------------------------------------------
+ */
+static void
+ProfTimerSignal (signalNum)
+    int signalNum;
+{
+    if (profTimerProc != NULL)
+        (*profTimerProc) ();
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+ * TclXOSsetproftimer --
+ *   System dependent interface to a repeating timer that counts the CPU time
+ * used by the process (ITIMER_PROF), used for sampling profiles.  The tick
+ * function is called from a signal handler, so it may only do things that
+ * are safe there.
+ *
+ * Parameters:
+ *   o interp - Errors returned in result.
+ *   o usecs - Interval between ticks, in microseconds.  Zero stops the timer
+ *     and restores the previous SIGPROF action.  A tick that is pending in
+ *     the calling thread is discarded, so the tick function is not called
+ *     by this thread once the timer is stopped.
+ *   o tickProc - Function to call on each tick.
+ *   o funcName - Command or other name to use in not available error.
+ * Results:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclXOSsetproftimer (interp, usecs, tickProc, funcName)
+    Tcl_Interp      *interp;
+    long             usecs;
+    TclXOSTimerProc *tickProc;
+    char            *funcName;
+{
+#if !defined(NO_SETITIMER) && defined(ITIMER_PROF) && defined(SIGPROF)
+    struct itimerval timer;
+#ifndef NO_SIGACTION
+    struct sigaction newAction;
+    sigset_t profSet, oldSet;
+#endif
+
+    timer.it_value.tv_sec = usecs / TCL_USECS_PER_SEC;
+    timer.it_value.tv_usec = usecs % TCL_USECS_PER_SEC;
+    timer.it_interval = timer.it_value;
+
+    if (usecs == 0) {
+#ifndef NO_SIGACTION
+        /*
+         * Block SIGPROF while the timer is stopped.  Ignoring the signal
+         * discards one that is already pending, rather than delivering it to
+         * the restored action when it is unblocked.
+         */
+        sigemptyset (&profSet);
+        sigaddset (&profSet, SIGPROF);
+        sigprocmask (SIG_BLOCK, &profSet, &oldSet);
+        setitimer (ITIMER_PROF, &timer, NULL);
+        profTimerProc = NULL;
+        newAction.sa_handler = SIG_IGN;
+        sigemptyset (&newAction.sa_mask);
+        newAction.sa_flags = 0;
+        sigaction (SIGPROF, &newAction, NULL);
+        sigaction (SIGPROF, &profOldAction, NULL);
+        sigprocmask (SIG_SETMASK, &oldSet, NULL);
+#else
+        setitimer (ITIMER_PROF, &timer, NULL);
+        profTimerProc = NULL;
+        signal (SIGPROF, profOldAction);
+#endif
+        return TCL_OK;
+    }
+
+    profTimerProc = tickProc;
+#ifndef NO_SIGACTION
+    newAction.sa_handler = ProfTimerSignal;
+    sigemptyset (&newAction.sa_mask);
+    newAction.sa_flags = 0;
+#ifdef SA_RESTART
+    newAction.sa_flags |= SA_RESTART;
+#endif
+    if (sigaction (SIGPROF, &newAction, &profOldAction) < 0)
+        goto posixError;
+#else
+    profOldAction = signal (SIGPROF, ProfTimerSignal);
+    if (profOldAction == SIG_ERR)
+        goto posixError;
+#endif
+
+    if (setitimer (ITIMER_PROF, &timer, NULL) < 0) {
+        TclX_AppendObjResult (interp, "unable to obtain timer: ",
+                              Tcl_PosixError (interp), (char *) NULL);
+#ifndef NO_SIGACTION
+        sigaction (SIGPROF, &profOldAction, NULL);
+#else
+        signal (SIGPROF, profOldAction);
+#endif
+        profTimerProc = NULL;
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+
+  posixError:
+    profTimerProc = NULL;
+    TclX_AppendObjResult (interp, "unable to set SIGPROF handler: ",
+                          Tcl_PosixError (interp), (char *) NULL);
+    return TCL_ERROR;
+#else
+    return TclXNotAvailableError (interp, funcName);
+#endif
+}
+
 /*-----------------------------------------------------------------------------
  * TclXOSsleep --
  *   System dependent interface to sleep functionality.
@@ -542,20 +676,88 @@ TclX_OSsymlink (interp, srcPath, targetPath, funcName)
 #endif
 }
 
+/*-----------------------------------------------------------------------------
+ * TclXOSheapsize --
+ *   System dependent interface to get the number of bytes of heap memory
+ * allocated by the process, including large blocks that malloc obtained
+ * with mmap.  This uses mallinfo2 with GNU libc, or mallinfo with versions
+ * before 2.33, where the count wraps at 4 gigabytes.  On Darwin, the
+ * statistics of all malloc zones are used.  Define NO_MALLINFO if mallinfo
+ * is not usable.
+ *
+ * Parameters:
+ *   o interp - Errors returned in result.
+ *   o sizePtr - The number of bytes allocated is returned here.
+ *   o funcName - Command or other name to use in not available error.
+ * Results:
+ *   TCL_OK or TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclXOSheapsize (interp, sizePtr, funcName)
+    Tcl_Interp  *interp;
+    Tcl_WideInt *sizePtr;
+    char        *funcName;
+{
+#if defined(__GLIBC__) && !defined(NO_MALLINFO)
+#   if (__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2 ();
+#   else
+    struct mallinfo info = mallinfo ();
+#   endif
+
+    *sizePtr = (Tcl_WideInt) info.uordblks + (Tcl_WideInt) info.hblkhd;
+    return TCL_OK;
+#elif defined(__APPLE__)
+    malloc_statistics_t stats;
+
+    malloc_zone_statistics (NULL, &stats);
+    *sizePtr = (Tcl_WideInt) stats.size_in_use;
+    return TCL_OK;
+#else
+    return TclXNotAvailableError (interp, funcName);
+#endif
+}
+
 /*-----------------------------------------------------------------------------
  * TclXOSElapsedTime --
- *   System dependent interface to get the elapsed CPU and real time. 
+ *   System dependent interface to get the elapsed CPU and real time.  The
+ * times are only meaningful relative to each other.  When clock_gettime is
+ * available, the real time is from the monotonic clock and the CPU time is
+ * that of the calling thread, both with nanosecond resolution.  Otherwise
+ * times() is used and the resolution is that of the clock tick.  Define
+ * NO_CLOCK_GETTIME to force the use of times().
  *
  * Parameters:
- *   o realTime - Elapsed real time, in milliseconds is returned here.
- *   o cpuTime - Elapsed CPU time, in milliseconds is returned here.
+ *   o realTime - Elapsed real time, in nanoseconds is returned here.
+ *   o cpuTime - Elapsed CPU time, in nanoseconds is returned here.
  *-----------------------------------------------------------------------------
  */
 void
 TclXOSElapsedTime (realTime, cpuTime)
-    clock_t *realTime;
-    clock_t *cpuTime;
+    Tcl_WideInt *realTime;
+    Tcl_WideInt *cpuTime;
 {
+#if defined(CLOCK_MONOTONIC) && !defined(NO_CLOCK_GETTIME)
+    struct timespec currentTime;
+
+    clock_gettime (CLOCK_MONOTONIC, &currentTime);
+    *realTime = ((Tcl_WideInt) currentTime.tv_sec * 1000000000) +
+        currentTime.tv_nsec;
+#   ifdef CLOCK_THREAD_CPUTIME_ID
+    clock_gettime (CLOCK_THREAD_CPUTIME_ID, &currentTime);
+    *cpuTime = ((Tcl_WideInt) currentTime.tv_sec * 1000000000) +
+        currentTime.tv_nsec;
+#   else
+    {
+        struct tms cpuTimes;
+
+        times (&cpuTimes);
+        *cpuTime = (Tcl_WideInt) TclXOSTicksToMS (cpuTimes.tms_utime +
+                                                  cpuTimes.tms_stime) * 1000000;
+    }
+#   endif
+#else
 /*
  * If times returns elapsed real time, this is easy.  If it returns a status,
  * real time must be obtained in other ways.
@@ -563,25 +765,20 @@ TclXOSElapsedTime (realTime, cpuTime)
 #ifndef TIMES_RETS_STATUS
     struct tms cpuTimes;
 
-    *realTime = TclXOSTicksToMS (times (&cpuTimes));
-    *cpuTime = TclXOSTicksToMS (cpuTimes.tms_utime + cpuTimes.tms_stime);
+    *realTime = (Tcl_WideInt) TclXOSTicksToMS (times (&cpuTimes)) * 1000000;
+    *cpuTime = (Tcl_WideInt) TclXOSTicksToMS (cpuTimes.tms_utime +
+                                              cpuTimes.tms_stime) * 1000000;
 #else
-    static struct timeval startTime = {0, 0};
     struct timeval currentTime;
     struct tms cpuTimes;
 
-    /*
-     * If this is the first call, get base time.
-     */
-    if ((startTime.tv_sec == 0) && (startTime.tv_usec == 0))
-        gettimeofday (&startTime, NULL);
-    
     gettimeofday (&currentTime, NULL);
-    currentTime.tv_sec  = currentTime.tv_sec  - startTime.tv_sec;
-    currentTime.tv_usec = currentTime.tv_usec - startTime.tv_usec;
-    *realTime = (currentTime.tv_sec  * 1000) + (currentTime.tv_usec / 1000);
+    *realTime = ((Tcl_WideInt) currentTime.tv_sec * 1000000000) +
+        ((Tcl_WideInt) currentTime.tv_usec * 1000);
     times (&cpuTimes);
-    *cpuTime = TclXOSTicksToMS (cpuTimes.tms_utime + cpuTimes.tms_stime);
+    *cpuTime = (Tcl_WideInt) TclXOSTicksToMS (cpuTimes.tms_utime +
+                                              cpuTimes.tms_stime) * 1000000;
+#endif
 #endif
 }
 
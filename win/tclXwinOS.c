@@ -417,6 +417,52 @@ TclXOSsetitimer (Tcl_Interp *interp,
     return TclXNotAvailableError (interp, funcName);
 }
 
+/*-----------------------------------------------------------------------------
+ * TclXOSsetproftimer --
+ *   System dependent interface to a profiling timer, which is not available
+ * on windows.
+ *
+ * Parameters:
+ *   o interp - Errors returned in result.
+ *   o usecs - Interval between ticks, in microseconds.
+ *   o tickProc - Function to call on each tick.
+ *   o funcName - Command or other name to use in not available error.
+ * Results:
+ *   TCL_ERROR, or TCL_OK when stopping the timer.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclXOSsetproftimer (Tcl_Interp      *interp,
+                    long             usecs,
+                    TclXOSTimerProc *tickProc,
+                    char            *funcName)
+{
+    if (usecs == 0)
+        return TCL_OK;
+    return TclXNotAvailableError (interp, funcName);
+}
+
+/*-----------------------------------------------------------------------------
+ * TclXOSheapsize --
+ *   System dependent interface to get the number of bytes of heap memory
+ * allocated by the process, which is not available on windows.
+ *
+ * Parameters:
+ *   o interp - Errors returned in result.
+ *   o sizePtr - The number of bytes allocated would be returned here.
+ *   o funcName - Command or other name to use in not available error.
+ * Results:
+ *   TCL_ERROR.
+ *-----------------------------------------------------------------------------
+ */
+int
+TclXOSheapsize (Tcl_Interp  *interp,
+                Tcl_WideInt *sizePtr,
+                char        *funcName)
+{
+    return TclXNotAvailableError (interp, funcName);
+}
+
 /*-----------------------------------------------------------------------------
  * TclXOSsleep --
  *   System dependent interface to sleep functionality.
@@ -560,28 +606,46 @@ TclX_OSsymlink (Tcl_Interp *interp,
 
 /*-----------------------------------------------------------------------------
  * TclXOSElapsedTime --
- *   System dependent interface to get the elapsed CPU and real time.  CPU time
- * is not available under windows and zero is always returned.
+ *   System dependent interface to get the elapsed CPU and real time.  The
+ * real time is from the performance counter.  The CPU time is that of the
+ * calling thread, which Windows counts in 100 nanosecond units but only
+ * updates on each clock tick.  If the thread times are not available, zero
+ * is returned for the CPU time.
  *
  * Parameters:
- *   o realTime - Elapsed real time, in milliseconds is returned here.
- *   o cpuTime - Elapsed CPU time, zero is always returned.
+ *   o realTime - Elapsed real time, in nanoseconds is returned here.
+ *   o cpuTime - Elapsed CPU time, in nanoseconds is returned here.
  *-----------------------------------------------------------------------------
  */
 void
-TclXOSElapsedTime (clock_t *realTime,
-                   clock_t *cpuTime)
+TclXOSElapsedTime (Tcl_WideInt *realTime,
+                   Tcl_WideInt *cpuTime)
 {
-    static DWORD startTime = 0;
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    FILETIME creationTime, exitTime, kernelTime, userTime;
   
     /*
-     * If this is the first call, get base time.
+     * If this is the first call, get the counter frequency.
      */
-    if (startTime == 0) {
-	startTime = GetTickCount ();
+    if (frequency.QuadPart == 0) {
+	QueryPerformanceFrequency (&frequency);
+    }
+    QueryPerformanceCounter (&counter);
+    *realTime = (Tcl_WideInt)
+	((counter.QuadPart / frequency.QuadPart) * 1000000000 +
+	 ((counter.QuadPart % frequency.QuadPart) * 1000000000) /
+	 frequency.QuadPart);
+
+    if (GetThreadTimes (GetCurrentThread (), &creationTime, &exitTime,
+			&kernelTime, &userTime)) {
+	*cpuTime = ((((Tcl_WideInt) kernelTime.dwHighDateTime << 32) |
+		     kernelTime.dwLowDateTime) +
+		    (((Tcl_WideInt) userTime.dwHighDateTime << 32) |
+		     userTime.dwLowDateTime)) * 100;
+    } else {
+	*cpuTime = 0;
     }
-    *realTime = GetTickCount () - startTime;
-    *cpuTime = 0;
 }
 
 /*-----------------------------------------------------------------------------